@@ -0,0 +1,131 @@
+#ifndef CLOCK_C
+#define CLOCK_C
+#include "include/clock.h"
+#include "include/lib.h"
+#include "include/pit.h"
+uint32_t tsc_khz    = 0;
+uint32_t clock_mult = 0;
+uint64_t tsc_base   = 0;
+/*
+ * div64_32
+ *   DESCRIPTION: divides a 64 bit value by a 32 bit one with divl, there is
+ *                no libgcc to provide the 64 bit division helpers
+ *   INPUTS: n - dividend, replaced by the quotient
+ *           base - divisor
+ *   OUTPUTS: none
+ *   RETURN VALUE: remainder
+ *   SIDE EFFECTS: none
+ */
+uint32_t div64_32(uint64_t* n, uint32_t base)
+{
+    uint32_t hi   = (uint32_t)(*n >> 32);
+    uint32_t lo   = (uint32_t)*n;
+    uint32_t q_hi = 0;
+    uint32_t rem;
+    if (hi >= base) { /* keep the divl quotient within 32 bits */
+	q_hi = hi / base;
+	hi   = hi % base;
+    }
+    asm("divl %4" : "=a"(lo), "=d"(rem) : "0"(lo), "1"(hi), "rm"(base) : "cc");
+    *n = ((uint64_t)q_hi << 32) | lo;
+    return rem;
+}
+/*
+ * has_tsc
+ *   DESCRIPTION: checks cpuid for a time stamp counter
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: 1 if rdtsc is available, 0 otherwise
+ *   SIDE EFFECTS: none
+ */
+static int32_t has_tsc()
+{
+    uint32_t eax = 1, ebx, ecx, edx;
+    asm volatile("cpuid" : "+a"(eax), "=b"(ebx), "=c"(ecx), "=d"(edx));
+    return (edx & CPUID_FEAT_TSC) ? 1 : 0;
+}
+/*
+ * clock_init
+ *   DESCRIPTION: calibrates the TSC by counting cycles while PIT channel two
+ *                runs CALIBRATE_MS worth of counts, then derives the cycles
+ *                to ns multiplier
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: uses PIT channel two and leaves the speaker off
+ */
+void clock_init()
+{
+    uint32_t flags;
+    uint64_t start, end, khz;
+    if (!has_tsc())
+	return; /* clock_ns falls back to jiffies */
+    cli_and_save(flags);
+    /* gate channel two on, speaker off */
+    outb((inb(PIT_CH2_GATE_PORT) & ~PIT_CH2_SPEAKER) | PIT_CH2_GATE, PIT_CH2_GATE_PORT);
+    outb(PIT_CH2_ONESHOT_CMD, PIT_CMD_PORT);
+    outb(CALIBRATE_COUNT & 0xFF, PIT_CH2_PORT);
+    outb((CALIBRATE_COUNT >> 8) & 0xFF, PIT_CH2_PORT);
+    start = rdtsc();
+    while ((inb(PIT_CH2_GATE_PORT) & PIT_CH2_OUT) == 0);
+    end = rdtsc();
+    restore_flags(flags);
+    khz = end - start;
+    div64_32(&khz, CALIBRATE_MS);
+    if (khz == 0 || (khz >> 32) != 0)
+	return;
+    tsc_khz  = (uint32_t)khz;
+    /* mult = (NSEC_PER_MSEC << CLOCK_SHIFT) / tsc_khz */
+    khz = (uint64_t)NSEC_PER_MSEC << CLOCK_SHIFT;
+    div64_32(&khz, tsc_khz);
+    clock_mult = (uint32_t)khz;
+    tsc_base   = start;
+}
+/*
+ * cycles_to_ns
+ *   DESCRIPTION: scales a TSC cycle count to ns with a multiply and shift
+ *   INPUTS: cycles - cycle count
+ *   OUTPUTS: none
+ *   RETURN VALUE: ns
+ *   SIDE EFFECTS: none
+ */
+uint64_t cycles_to_ns(uint64_t cycles)
+{
+    uint32_t lo = (uint32_t)cycles;
+    uint32_t hi = (uint32_t)(cycles >> 32);
+    /* split so neither 32x32 product overflows 64 bits */
+    return (((uint64_t)lo * clock_mult) >> CLOCK_SHIFT) +
+	   (((uint64_t)hi * clock_mult) << (32 - CLOCK_SHIFT));
+}
+/*
+ * clock_ns
+ *   DESCRIPTION: monotonic clock in ns since calibration, tick granularity
+ *                when the CPU has no TSC
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: ns
+ *   SIDE EFFECTS: none
+ */
+uint64_t clock_ns()
+{
+    if (tsc_khz == 0)
+	return (uint64_t)jiffies * TICK_NSEC;
+    return cycles_to_ns(rdtsc() - tsc_base);
+}
+/*
+ * ns_to_timespec
+ *   DESCRIPTION: splits a ns count into seconds and ns
+ *   INPUTS: ns - time in ns
+ *           ts - timespec to fill
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+void ns_to_timespec(uint64_t ns, timespec_t* ts)
+{
+    if (ts == NULL)
+	return;
+    ts->tv_nsec = (int32_t)div64_32(&ns, NSEC_PER_SEC);
+    ts->tv_sec  = (int32_t)ns;
+}
+#endif
@@ -0,0 +1,166 @@
+#ifndef EXEC_CACHE_C
+#define EXEC_CACHE_C
+#include "include/exec_cache.h"
+#include "include/fs.h"
+#include "include/task.h"
+#include "include/lib.h"
+#include "include/sys_call.h"
+#define REGULAR_FILE 2 // dentry_t file_type of a data file
+static exec_image_t exec_cache[EXEC_CACHE_ENTRIES];
+static uint8_t exec_cache_data[EXEC_CACHE_ENTRIES][EXEC_CACHE_IMAGE_SIZE];
+static exec_image_t exec_uncached; /* image of the last miss, returned if too large for the cache */
+static uint32_t exec_cache_clock;
+uint32_t exec_cache_hits;
+uint32_t exec_cache_misses;
+/*
+ * exec_parse
+ *   DESCRIPTION: checks the ELF header of an image and collects its PT_LOAD
+ *                segments. Every segment has to fit the user page and be
+ *                backed by the file up to filesz, and the entry point has
+ *                to be in an executable segment.
+ *   INPUTS: e -- image with inode_num, length and header filled in
+ *   OUTPUTS: e->nsegs, e->segs, staged offsets as if packed back to back
+ *   RETURN VALUE: total file bytes of the segments, -1 if the image cannot
+ *                 be loaded
+ *   SIDE EFFECTS: none
+ */
+static int32_t exec_parse(exec_image_t* e)
+{
+    elf_program_header_t ph[ELF_MAX_PHNUM];
+    elf_header_t* h = &e->header;
+    uint32_t staged = 0;
+    uint32_t i;
+    int32_t entry_ok = 0;
+    if (h->ident[0] != ELF_MAGIC_WORD_0 || h->ident[1] != ELF_MAGIC_WORD_1 ||
+	    h->ident[2] != ELF_MAGIC_WORD_2 || h->ident[3] != ELF_MAGIC_WORD_3 ||
+	    h->ident[ELF_CLASS] != ELF_CLASS32)
+	return -1;
+    if (h->phentsize != sizeof(elf_program_header_t) || h->phnum == 0 || h->phnum > ELF_MAX_PHNUM ||
+	    h->phoff > e->length || h->phnum * sizeof(elf_program_header_t) > e->length - h->phoff)
+	return -1;
+    read_data(e->inode_num, h->phoff, (uint8_t*)ph, h->phnum * sizeof(elf_program_header_t));
+    e->nsegs = 0;
+    for (i = 0; i < h->phnum; i++) {
+	exec_segment_t* s;
+	if (ph[i].type != PT_LOAD)
+	    continue;
+	if (e->nsegs == EXEC_MAX_SEGMENTS || ph[i].filesz > ph[i].memsz ||
+		ph[i].offset > e->length || ph[i].filesz > e->length - ph[i].offset ||
+		ph[i].vaddr < START_OF_USER || ph[i].memsz > START_OF_USER + __4MB__ - ph[i].vaddr)
+	    return -1;
+	s = &e->segs[e->nsegs++];
+	s->offset = ph[i].offset;
+	s->vaddr  = ph[i].vaddr;
+	s->filesz = ph[i].filesz;
+	s->memsz  = ph[i].memsz;
+	s->flags  = ph[i].flags;
+	s->staged = staged;
+	staged   += s->filesz;
+	if ((s->flags & PF_X) && h->entry >= s->vaddr && h->entry - s->vaddr < s->memsz)
+	    entry_ok = 1;
+    }
+    if (e->nsegs == 0 || !entry_ok)
+	return -1;
+    return staged;
+}
+/*
+ * exec_cache_get
+ *   DESCRIPTION: finds the executable behind a name. One directory lookup
+ *                resolves the inode, a cached image of it is returned as
+ *                is. Otherwise the headers are parsed and the segments
+ *                staged in the least recently used entry.
+ *   INPUTS: name -- file name, in kernel memory
+ *   OUTPUTS: none
+ *   RETURN VALUE: the image, NULL if there is no such file or it is not
+ *                 an ELF executable that fits the user page
+ *   SIDE EFFECTS: a miss may evict another image
+ */
+exec_image_t* exec_cache_get(const uint8_t* name)
+{
+    dentry_t dentry;
+    inode_t* inode;
+    exec_image_t* e;
+    exec_image_t* victim = &exec_cache[0];
+    int32_t i, staged;
+    if (read_dentry_by_name(name, &dentry) == -1 || dentry.file_type != REGULAR_FILE)
+	return NULL;
+    inode = (inode_t*)((uint8_t*)fs_img_addr + (dentry.inode_num + 1) * BLOCK_SIZE);
+    for (i = 0; i < EXEC_CACHE_ENTRIES; i++) {
+	e = &exec_cache[i];
+	if (e->valid && e->inode_num == dentry.inode_num && e->length == inode->length) {
+	    e->last_used = ++exec_cache_clock;
+	    exec_cache_hits++;
+	    return e;
+	}
+	if (!e->valid)
+	    victim = e;
+	else if (victim->valid && e->last_used < victim->last_used)
+	    victim = e;
+    }
+    exec_cache_misses++;
+    if (inode->length < sizeof(elf_header_t))
+	return NULL;
+    /* parse aside, an image too large for the cache evicts nothing */
+    e = &exec_uncached;
+    e->valid     = 0;
+    e->inode_num = dentry.inode_num;
+    e->length    = inode->length;
+    e->data      = NULL;
+    read_data(dentry.inode_num, 0, (uint8_t*)&e->header, sizeof(elf_header_t));
+    staged = exec_parse(e);
+    if (staged == -1)
+	return NULL;
+    if (staged <= EXEC_CACHE_IMAGE_SIZE) {
+	memcpy(victim, e, sizeof(exec_image_t));
+	e = victim;
+	e->data = exec_cache_data[e - exec_cache];
+	for (i = 0; i < e->nsegs; i++)
+	    read_data(e->inode_num, e->segs[i].offset, e->data + e->segs[i].staged, e->segs[i].filesz);
+    }
+    e->last_used = ++exec_cache_clock;
+    e->valid     = 1;
+    return e;
+}
+/*
+ * exec_cache_load
+ *   DESCRIPTION: copies the file bytes of every segment to its address and
+ *                zero fills the rest of it, the bss. Headers, symbols and
+ *                debug sections outside the segments are never copied.
+ *   INPUTS: image -- image from exec_cache_get
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: writes the user page of the new process, which must be
+ *                 mapped. The page is one writable 4MB mapping, segment
+ *                 permissions were checked by exec_parse.
+ */
+void exec_cache_load(exec_image_t* image)
+{
+    uint32_t i;
+    for (i = 0; i < image->nsegs; i++) {
+	exec_segment_t* s = &image->segs[i];
+	if (image->data != NULL)
+	    memcpy((uint8_t*)s->vaddr, image->data + s->staged, s->filesz);
+	else
+	    read_data(image->inode_num, s->offset, (uint8_t*)s->vaddr, s->filesz);
+	memset((uint8_t*)s->vaddr + s->filesz, 0, s->memsz - s->filesz);
+    }
+}
+/*
+ * exec_cache_invalidate
+ *   DESCRIPTION: drops the cached image of a file that is written to
+ *   INPUTS: inode_num -- inode of the file
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: the next execute of the file stages it again
+ */
+void exec_cache_invalidate(uint32_t inode_num)
+{
+    int32_t i;
+    for (i = 0; i < EXEC_CACHE_ENTRIES; i++) {
+	if (exec_cache[i].inode_num == inode_num)
+	    exec_cache[i].valid = 0;
+    }
+    if (exec_uncached.inode_num == inode_num)
+	exec_uncached.valid = 0;
+}
+#endif
@@ -0,0 +1,117 @@
+#ifndef FPU_C
+#define FPU_C
+#include "include/fpu.h"
+#include "include/idt.h"
+#include "include/sched.h"
+#include "include/x86_desc.h"
+struct process_control_block* fpu_owner = NULL;
+uint8_t fpu_enabled = 0;
+static fxsave_t fpu_init_state; /* state right after fninit, loaded on a task's first use */
+/*
+ * has_fxsr
+ *   DESCRIPTION: checks cpuid for fxsave/fxrstor and SSE
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: 1 if both are available, 0 otherwise
+ *   SIDE EFFECTS: none
+ */
+static int32_t has_fxsr()
+{
+    uint32_t eax = 1, ebx, ecx, edx;
+    asm volatile("cpuid" : "+a"(eax), "=b"(ebx), "=c"(ecx), "=d"(edx));
+    return ((edx & CPUID_FEAT_FXSR) && (edx & CPUID_FEAT_SSE)) ? 1 : 0;
+}
+/*
+ * fpu_init
+ *   DESCRIPTION: turns on the FPU and SSE (CR0.EM off, CR4.OSFXSR and
+ *                OSXMMEXCPT on), records a clean register image for new
+ *                tasks and installs the #NM handler. TS is left set so the
+ *                first task to touch the FPU takes the fault.
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: modifies CR0, CR4 and IDT entry 7
+ */
+void fpu_init()
+{
+    uint32_t cr0, cr4;
+    if (!has_fxsr())
+	return;
+    asm volatile("movl %%cr0, %0" : "=r"(cr0));
+    cr0 &= ~(CR0_EM | CR0_TS);
+    cr0 |= CR0_MP | CR0_NE;
+    asm volatile("movl %0, %%cr0" :: "r"(cr0) : "memory");
+    asm volatile("movl %%cr4, %0" : "=r"(cr4));
+    cr4 |= CR4_OSFXSR | CR4_OSXMMEXCPT;
+    asm volatile("movl %0, %%cr4" :: "r"(cr4) : "memory");
+
+    asm volatile("fninit; fxsave %0" : "=m"(fpu_init_state) :: "memory");
+    fill_interrupt(DEVICE_NA_VEC, (uint32_t*)fpu_linkage, KERNEL_CS, 0x8E00); // interrupt gate, DPL 0
+    fpu_enabled = 1;
+    stts();
+}
+/*
+ * math_state_restore
+ *   DESCRIPTION: #NM handler. Saves the registers of the previous owner into
+ *                its pcb, loads the state of current_proc (or a clean state
+ *                on its first use) and lets it continue with TS clear.
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: changes fpu_owner
+ */
+void math_state_restore()
+{
+    clts();
+    if (fpu_owner == current_proc)
+	return;
+    if (fpu_owner != NULL)
+	asm volatile("fxsave %0" : "=m"(fpu_owner->fpu) :: "memory");
+    if (current_proc->used_math) {
+	asm volatile("fxrstor %0" :: "m"(current_proc->fpu) : "memory");
+    } else {
+	asm volatile("fxrstor %0" :: "m"(fpu_init_state) : "memory");
+	current_proc->used_math = 1;
+    }
+    fpu_owner = current_proc;
+}
+/*
+ * fpu_switch
+ *   DESCRIPTION: called on every switch into next. The registers stay where
+ *                they are, TS is only cleared when next already owns them so
+ *                tasks that never touch the FPU never pay for a save.
+ *   INPUTS: next - task about to run
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: modifies CR0.TS
+ */
+void fpu_switch(struct process_control_block* next)
+{
+    if (!fpu_enabled)
+	return;
+    if (next == fpu_owner)
+	clts();
+    else
+	stts();
+}
+/*
+ * fpu_release
+ *   DESCRIPTION: drops the FPU state of an exiting task so the pid's next
+ *                user starts clean and nobody saves into a dead pcb
+ *   INPUTS: p - task being torn down
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: may clear fpu_owner and set CR0.TS
+ */
+void fpu_release(struct process_control_block* p)
+{
+    if (p == NULL)
+	return;
+    p->used_math = 0;
+    if (fpu_owner == p) {
+	fpu_owner = NULL;
+	if (fpu_enabled)
+	    stts();
+    }
+}
+#endif
@@ -5,6 +5,7 @@
 #include "include/task.h"
 #include "include/sys_call.h"
 #include "include/sched.h"
+#include "include/exec_cache.h"
 #define BLOCKS_PER_GROUP  16
 #define stdin		  0
 #define stdout		  1
@@ -330,6 +331,7 @@ int32_t write_data(uint32_t inode, uint32_t offset, uint8_t* buf, uint32_t lengt
 	return FS_ERROR;
     if (inode_ptr == NULL)
 	return FS_ERROR;
+    exec_cache_invalidate(inode); /* a staged copy of the file would be stale */
 
     /* if the memcpy will copy data that is out of bounds,
      * adjust the size of data to be transferred        */
@@ -672,6 +674,7 @@ void init_file_table(file_table_t* file_table)
     /* iterate over each file entry that can be supported by the OS. */
     for (index = 0; index < MAX_NUM_FD; index++) {
 	fs_t* fd = &files[index];	/* point to the corresponding entry in the files array */
+	fd->pipe = NULL;
 
 	/* stdin and stdout occupy the first two entries of the files array */
 	if (index == stdin) {
@@ -4,6 +4,7 @@
 
 #include "include/i8259.h"
 #include "include/lib.h"
+#include "include/spinlock.h"
 #define MASTER_LOW  0x0
 #define MASTER_HIGH 0x7
 #define SLAVE_LOW	0x8
@@ -11,6 +12,7 @@
 /* Interrupt masks to determine which interrupts are enabled and disabled */
 uint8_t master_mask = 0xff; /* IRQs 0-7  */
 uint8_t slave_mask = 0xff;  /* IRQs 8-15 */
+static DEFINE_SPINLOCK(i8259_lock); /* the masks and the data ports */
 
 /* i8259_init
  *  DESCRIPTION: initializes the master/slave pics in the IDT table and enables IRQ for both.
@@ -56,7 +58,7 @@ void i8259_init(void)
 void enable_irq(uint32_t irq_num)
 {
 	unsigned long flags;
-	cli_and_save(flags);
+	spin_lock_irqsave(&i8259_lock, flags);
   //Master
   if(irq_num < 8){ // Max of 8 IRQ lines per PIC
     master_mask = master_mask & ~(0x01 << irq_num);
@@ -67,7 +69,7 @@ void enable_irq(uint32_t irq_num)
     slave_mask = slave_mask & ~(0x01 << (irq_num-MASTER_PORT_COUNT));
     outb(slave_mask, SLAVE_8259_DATA);
   }
-	restore_flags(flags);
+	spin_unlock_irqrestore(&i8259_lock, flags);
 }
 
 /* disable_irq
@@ -80,7 +82,7 @@ void enable_irq(uint32_t irq_num)
 void disable_irq(uint32_t irq_num)
 {
 	unsigned long flags;
-	cli_and_save(flags);
+	spin_lock_irqsave(&i8259_lock, flags);
   //Master
   if(irq_num < 8){ // Max of 8 IRQ lines per PIC
     master_mask = master_mask | (0x01 << irq_num);
@@ -91,7 +93,7 @@ void disable_irq(uint32_t irq_num)
     slave_mask = slave_mask | (0x01 << (irq_num-MASTER_PORT_COUNT));
     outb(slave_mask, SLAVE_8259_DATA);
   }
-	restore_flags(flags);
+	spin_unlock_irqrestore(&i8259_lock, flags);
 }
 
 /* send_eoi
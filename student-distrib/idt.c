@@ -120,7 +120,7 @@ void exception_handler(int num)
 {
   vga_printf((int8_t *)exceptionMsg[num]);
 
-	if(curr_pid == 0) // If the execption happens in the kernel stop and show kill screen
+	if(curr_pid == 0 || pid_htable.pids[curr_pid].pcb.is_kthread) // If the execption happens in the kernel stop and show kill screen
 	{
 		show_kill_screen();
 		while(1);
@@ -0,0 +1,51 @@
+#ifndef CLOCK_H
+#define CLOCK_H
+#include "types.h"
+#include "pit.h"
+#define NSEC_PER_SEC        1000000000
+#define NSEC_PER_MSEC       1000000
+#define NSEC_PER_USEC       1000
+#define CLOCK_SHIFT         22    // cycles to ns scale factor is mult / 2^CLOCK_SHIFT
+#define CALIBRATE_MS        50    // length of the PIT channel 2 calibration window
+#define CALIBRATE_COUNT     ((PIT_INPUT_HZ * CALIBRATE_MS) / 1000)
+#define PIT_CH2_PORT        0x42
+#define PIT_CH2_ONESHOT_CMD 0xB0  // Channel two, lo/hi config, mode 0
+#define PIT_CH2_GATE_PORT   0x61  // bit 0 gates channel two, bit 1 drives the speaker
+#define PIT_CH2_GATE        0x01
+#define PIT_CH2_SPEAKER     0x02
+#define PIT_CH2_OUT         0x20  // channel two output, set once the count runs out
+#define CPUID_FEAT_TSC      0x10  // EDX bit 4 of cpuid leaf 1
+/* tick length in ns, used when there is no TSC */
+#define TICK_NSEC           ((uint32_t)(((uint64_t)RELOAD_VALUE * NSEC_PER_SEC) / PIT_INPUT_HZ))
+
+/* time value handed to user space by gettime */
+struct timespec {
+    int32_t tv_sec;
+    int32_t tv_nsec;
+};
+typedef struct timespec timespec_t;
+
+/*
+ * rdtsc
+ *  DESCRIPTION:  reads the time stamp counter
+ *  INPUTS:       none
+ *  OUTPUTS:      none
+ *  RETURN VALUE: 64 bit cycle count
+ *  SIDE EFFECTS: none
+ */
+static inline uint64_t rdtsc()
+{
+    uint32_t lo, hi;
+    asm volatile("rdtsc" : "=a"(lo), "=d"(hi));
+    return ((uint64_t)hi << 32) | lo;
+}
+
+extern uint32_t tsc_khz;      /* calibrated TSC frequency, 0 if there is no TSC */
+extern uint32_t clock_mult;   /* ns = cycles * clock_mult >> CLOCK_SHIFT */
+extern uint64_t tsc_base;     /* TSC value at calibration, time zero */
+extern void clock_init();     /* calibrate the TSC against the PIT */
+extern uint64_t clock_ns();   /* monotonic ns since clock_init */
+extern uint64_t cycles_to_ns(uint64_t cycles); /* scale a TSC delta to ns */
+extern uint32_t div64_32(uint64_t* n, uint32_t base); /* *n /= base, returns remainder */
+extern void ns_to_timespec(uint64_t ns, timespec_t* ts);
+#endif
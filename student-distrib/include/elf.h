@@ -0,0 +1,44 @@
+#ifndef ELF_H
+#define ELF_H
+#include "types.h"
+#define ELF_NIDENT      16
+#define ELF_CLASS       4  // ident byte holding the class
+#define ELF_CLASS32     1
+#define ELF_MAX_PHNUM   8  // program headers read by the loader
+#define PT_LOAD         1  // segment copied into memory
+#define PF_X            0x1
+#define PF_W            0x2
+#define PF_R            0x4
+
+/* ELF file header of a 32 bit executable, at offset 0 of the file */
+struct elf_header {
+    uint8_t  ident[ELF_NIDENT];  /* magic words, class, byte order */
+    uint16_t type;
+    uint16_t machine;
+    uint32_t version;
+    uint32_t entry;              /* user address execution starts at */
+    uint32_t phoff;              /* file offset of the program header table */
+    uint32_t shoff;              /* file offset of the section header table */
+    uint32_t flags;
+    uint16_t ehsize;
+    uint16_t phentsize;          /* size of one program header */
+    uint16_t phnum;              /* number of program headers */
+    uint16_t shentsize;
+    uint16_t shnum;
+    uint16_t shstrndx;
+} __attribute__((packed));
+typedef struct elf_header elf_header_t;
+
+/* program header, one per segment, phnum of them at phoff */
+struct elf_program_header {
+    uint32_t type;               /* PT_LOAD for what the loader copies */
+    uint32_t offset;             /* file offset of the segment */
+    uint32_t vaddr;              /* user address it is loaded at */
+    uint32_t paddr;
+    uint32_t filesz;             /* bytes taken from the file */
+    uint32_t memsz;              /* bytes in memory, zero filled past filesz */
+    uint32_t flags;              /* PF_R, PF_W, PF_X */
+    uint32_t align;
+} __attribute__((packed));
+typedef struct elf_program_header elf_program_header_t;
+#endif
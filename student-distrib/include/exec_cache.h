@@ -0,0 +1,40 @@
+#ifndef EXEC_CACHE_H
+#define EXEC_CACHE_H
+#include "types.h"
+#include "elf.h"
+#define EXEC_CACHE_ENTRIES      4
+#define EXEC_CACHE_IMAGE_SIZE   0xA000 // 40KB of segment file bytes, larger executables are read from the file every time
+#define EXEC_MAX_SEGMENTS       4      // PT_LOAD segments of one executable
+
+/* PT_LOAD segment checked against the user page */
+struct exec_segment {
+    uint32_t offset;          /* file offset of the bytes backed by the file */
+    uint32_t vaddr;
+    uint32_t filesz;
+    uint32_t memsz;           /* filesz plus the zero filled bss */
+    uint32_t flags;           /* PF_R, PF_W, PF_X */
+    uint32_t staged;          /* offset of the file bytes in data */
+};
+typedef struct exec_segment exec_segment_t;
+
+/* executable found by exec_cache_get. A cached image keeps the file bytes
+ * of its segments back to back, staged when it was first executed and
+ * copied to the user page from there afterwards. */
+struct exec_image {
+    uint32_t       inode_num; /* key */
+    uint32_t       length;    /* file length when the image was staged */
+    elf_header_t   header;
+    uint32_t       nsegs;
+    exec_segment_t segs[EXEC_MAX_SEGMENTS];
+    uint8_t*       data;      /* staged segments, NULL when they are read from the file */
+    uint32_t       last_used; /* exec_cache_clock at the last execute, for LRU */
+    uint8_t        valid;
+};
+typedef struct exec_image exec_image_t;
+
+extern uint32_t exec_cache_hits;
+extern uint32_t exec_cache_misses;
+extern exec_image_t* exec_cache_get(const uint8_t* name); /* NULL if name is no loadable executable */
+extern void exec_cache_load(exec_image_t* image);        /* into the mapped user page */
+extern void exec_cache_invalidate(uint32_t inode_num);   /* the file changed */
+#endif
@@ -0,0 +1,50 @@
+#ifndef FPU_H
+#define FPU_H
+#include "types.h"
+#define DEVICE_NA_VEC       0x07       // #NM, raised on FPU/SSE use while CR0.TS is set
+#define FXSAVE_SIZE         512        // bytes written by fxsave
+#define FXSAVE_ALIGN        16         // fxsave/fxrstor fault on unaligned areas
+#define CR0_MP              0x00000002 // monitor coprocessor, makes wait/fwait honour TS
+#define CR0_EM              0x00000004 // x87 emulation, must be clear for SSE
+#define CR0_TS              0x00000008 // task switched, next FPU/SSE use raises #NM
+#define CR0_NE              0x00000020 // report x87 errors through #MF
+#define CR4_OSFXSR          0x00000200 // OS supports fxsave/fxrstor and SSE
+#define CR4_OSXMMEXCPT      0x00000400 // OS handles #XM SIMD exceptions
+#define CPUID_FEAT_FXSR     0x01000000 // EDX bit 24 of cpuid leaf 1
+#define CPUID_FEAT_SSE      0x02000000 // EDX bit 25 of cpuid leaf 1
+
+/* x87/MMX/SSE register image in fxsave layout */
+struct fxsave_area {
+    uint8_t data[FXSAVE_SIZE];
+} __attribute__((aligned(FXSAVE_ALIGN)));
+typedef struct fxsave_area fxsave_t;
+
+/*
+ * clts / stts
+ *  DESCRIPTION:  clear or set CR0.TS
+ *  INPUTS:       none
+ *  OUTPUTS:      none
+ *  RETURN VALUE: none
+ *  SIDE EFFECTS: with TS set the next FPU/SSE instruction raises #NM
+ */
+static inline void clts()
+{
+    asm volatile("clts" ::: "memory");
+}
+static inline void stts()
+{
+    uint32_t cr0;
+    asm volatile("movl %%cr0, %0" : "=r"(cr0));
+    if (!(cr0 & CR0_TS))
+	asm volatile("movl %0, %%cr0" :: "r"(cr0 | CR0_TS) : "memory");
+}
+
+struct process_control_block;
+extern struct process_control_block* fpu_owner; /* task whose state is live in the FPU, NULL if none */
+extern uint8_t fpu_enabled;                       /* set once SSE and fxsave are switched on */
+extern void fpu_init();                           /* enable SSE and install the #NM handler */
+extern void math_state_restore();                 /* #NM handler, hands the FPU to current_proc */
+extern void fpu_switch(struct process_control_block* next); /* arm TS unless next owns the FPU */
+extern void fpu_release(struct process_control_block* p);   /* forget p's FPU state on exit */
+extern void fpu_linkage();                        /* assembly linkage for #NM */
+#endif
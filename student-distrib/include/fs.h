@@ -82,6 +82,7 @@ typedef struct fs_io
     uint32_t inode_num;        /* the dentry associated with the file   */
     uint32_t f_pos;            /* the current file position after the beginning */
     uint32_t flags;            /* the state of the current file           */
+    struct pipe* pipe;         /* pipe of a pipe end, NULL for other files */
 } fs_t;
 /* data structure for the boot block */
 typedef struct boot_block {
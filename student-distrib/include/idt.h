@@ -19,7 +19,10 @@ enum sys_calls {
      __GETARGS    = 7,
      __VIDMAP     = 8,
      __SETHANDLER = 9,
-     __SIGRETURN  = 10
+     __SIGRETURN  = 10,
+     __GETTIME    = 11,
+     __SLEEP      = 12,
+     __GETRUSAGE  = 13
 };
 extern uint32_t exception_flag;
 // Assembly linkages of all the exceptions/first 32 interrupts
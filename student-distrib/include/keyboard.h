@@ -32,6 +32,8 @@
 #define TAB_SIZE                          4 // Tab size
 #define ALTKEY                         0x38
 #define MAX_KEY_PRESS                    89
+#define KBD_FIFO_SIZE                   256 // scan codes buffered between the IRQ and the worker, power of 2, holds a pasted burst
+#define KBD_FIFO_MASK                    (KBD_FIFO_SIZE - 1)
 
 // structure used to easily access the upper, lower, caps, and shift caps characters
 struct key {
@@ -42,6 +44,64 @@ struct key {
 } __attribute__((packed));
 typedef struct key key_t;
 
+/* Scan codes on their way from the IRQ to the keyboard worker. There is
+ * one producer, the IRQ with interrupts off, and one consumer, the events
+ * worker. Each index is written by one side only, so neither takes a lock:
+ * x86 keeps stores in order and loads in order, a compiler barrier between
+ * the slot and the index is all either side needs. */
+struct kbd_ring {
+    uint8_t  code[KBD_FIFO_SIZE];
+    uint64_t stamp[KBD_FIFO_SIZE];  /* clock_ns at which each scan code arrived */
+    volatile uint32_t head;         /* next slot to read, written by the consumer */
+    volatile uint32_t tail;         /* next slot to fill, written by the producer */
+    uint32_t dropped;               /* scan codes lost to a full ring */
+};
+typedef struct kbd_ring kbd_ring_t;
+
+/*
+ * kbd_ring_push
+ *  DESCRIPTION:  producer side, stores a scan code and then publishes it
+ *  INPUTS:       r -- ring
+ *                code, stamp -- scan code and its arrival time
+ *  OUTPUTS:      none
+ *  RETURN VALUE: 1 if stored, 0 if the ring was full
+ *  SIDE EFFECTS: counts the drop when full
+ */
+static inline int32_t kbd_ring_push(kbd_ring_t* r, uint8_t code, uint64_t stamp)
+{
+    uint32_t tail = r->tail;
+    if (tail - r->head >= KBD_FIFO_SIZE) {
+	r->dropped++;
+	return 0;
+    }
+    r->code[tail & KBD_FIFO_MASK]  = code;
+    r->stamp[tail & KBD_FIFO_MASK] = stamp;
+    asm volatile("" ::: "memory"); /* slot filled before the consumer can see it */
+    r->tail = tail + 1;
+    return 1;
+}
+/*
+ * kbd_ring_pop
+ *  DESCRIPTION:  consumer side, takes the oldest scan code and hands its
+ *                slot back to the producer
+ *  INPUTS:       r -- ring
+ *  OUTPUTS:      code, stamp
+ *  RETURN VALUE: 1 if a scan code was taken, 0 if the ring was empty
+ *  SIDE EFFECTS: none
+ */
+static inline int32_t kbd_ring_pop(kbd_ring_t* r, uint8_t* code, uint64_t* stamp)
+{
+    uint32_t head = r->head;
+    if (head == r->tail)
+	return 0;
+    asm volatile("" ::: "memory"); /* slot read only after the tail that published it */
+    *code  = r->code[head & KBD_FIFO_MASK];
+    *stamp = r->stamp[head & KBD_FIFO_MASK];
+    asm volatile("" ::: "memory"); /* slot read before the producer may refill it */
+    r->head = head + 1;
+    return 1;
+}
+
 /*Assembly linkage for the keyboard handler*/
 extern void keyboard_linkage();
 
@@ -0,0 +1,13 @@
+#ifndef KTHREAD_H
+#define KTHREAD_H
+#include "types.h"
+#include "task.h"
+#define KTHREAD_PID_MAX     31  // kernel threads take pids from the top of the 32 bit pid bitmap down
+#define KTHREAD_PID_MIN     16  // so user processes keep their low pids and physical pages
+
+typedef void (*kthread_fn_t)(uint32_t data);
+
+extern proc_t* kthread_create(kthread_fn_t fn, uint32_t data, const int8_t* name, uint8_t priority); /* start a kernel thread */
+extern void kthread_exit();  /* called when a kernel thread function returns, never returns */
+extern void kthread_start(); /* first return address of a kernel thread, sched_asm.S */
+#endif
@@ -136,6 +136,18 @@ static inline uint32_t inl(port) {
     );
     return val;
 }
+
+/* Reads the low 32 bits of a model specific register */
+static inline uint32_t rdmsr(uint32_t msr) {
+    uint32_t lo, hi;
+    asm volatile ("rdmsr" : "=a"(lo), "=d"(hi) : "c"(msr));
+    return lo;
+}
+
+/* Writes a model specific register, hi:lo */
+static inline void wrmsr(uint32_t msr, uint32_t lo, uint32_t hi) {
+    asm volatile ("wrmsr" : : "c"(msr), "a"(lo), "d"(hi) : "memory");
+}
 /* Bitscan operations. bitscan_reverse returns
  * position of MSB that is set
  * bitscan_forward returns the position of LSB
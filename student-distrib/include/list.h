@@ -0,0 +1,154 @@
+#ifndef LIST_H
+#define LIST_H
+#include "types.h"
+/* intrusive doubly linked list: the node is embedded in the structure it
+ * links, a list is a circular chain through a head node that is never an
+ * entry itself. Every operation is O(1) and takes the list explicitly. */
+struct list_head {
+    struct list_head* next;
+    struct list_head* prev;
+};
+typedef struct list_head list_head_t;
+
+/* helper macro to statically initialize a list head */
+#define LIST_HEAD_INIT(name)	    { &(name), &(name) }
+
+/* helper macro to define an empty list head */
+#define LIST_HEAD(name)		    \
+    struct list_head name = LIST_HEAD_INIT(name)
+
+/* structure a node is embedded in, e.g. list_entry(node, proc_t, run_list) */
+#define list_entry(ptr, type, member)	    \
+    ((type*)((uint8_t*)(ptr) - (uint32_t)(&((type*)0)->member)))
+
+/* first and last entry, the list must not be empty */
+#define list_first_entry(head, type, member)	list_entry((head)->next, type, member)
+#define list_last_entry(head, type, member)	list_entry((head)->prev, type, member)
+
+/* iterate over the nodes of a list, pos must not be removed */
+#define list_for_each(pos, head)	    \
+    for ((pos) = (head)->next; (pos) != (head); (pos) = (pos)->next)
+
+/* iterate over the nodes of a list, n keeps the walk going if pos is removed */
+#define list_for_each_safe(pos, n, head)    \
+    for ((pos) = (head)->next, (n) = (pos)->next; (pos) != (head); (pos) = (n), (n) = (pos)->next)
+
+/*
+ * INIT_LIST_HEAD
+ *  DESCRIPTION : initializes an empty list, or a node that is on no list
+ *  INPUT       : list -- head or node to initialize
+ *  OUTPUTS     : none
+ *  RETURN VALUE: none
+ *  SIDE EFFECTS: points next and prev at list itself
+ */
+static inline void INIT_LIST_HEAD(struct list_head* list)
+{
+    list->next = list;
+    list->prev = list;
+}
+/*
+ * __list_add
+ *  DESCRIPTION : links node between two consecutive nodes
+ *  INPUT       : node -- node to insert
+ *                prev, next -- its neighbours to be
+ *  OUTPUTS     : none
+ *  RETURN VALUE: none
+ *  SIDE EFFECTS: none
+ */
+static inline void __list_add(struct list_head* node, struct list_head* prev, struct list_head* next)
+{
+    next->prev = node;
+    node->next = next;
+    node->prev = prev;
+    prev->next = node;
+}
+/*
+ * list_add / list_add_tail
+ *  DESCRIPTION : inserts node right after head (stack) or right before it,
+ *                at the end of the list (queue)
+ *  INPUT       : node -- node to insert
+ *                head -- list to insert it in
+ *  OUTPUTS     : none
+ *  RETURN VALUE: none
+ *  SIDE EFFECTS: none
+ */
+static inline void list_add(struct list_head* node, struct list_head* head)
+{
+    __list_add(node, head, head->next);
+}
+static inline void list_add_tail(struct list_head* node, struct list_head* head)
+{
+    __list_add(node, head->prev, head);
+}
+/*
+ * list_del / list_del_init
+ *  DESCRIPTION : unlinks node from whatever list it is on, without walking
+ *                the list. list_del_init leaves node as an empty list so
+ *                list_empty(node) tells whether it is linked.
+ *  INPUT       : node -- node to remove
+ *  OUTPUTS     : none
+ *  RETURN VALUE: none
+ *  SIDE EFFECTS: list_del leaves node's links NULL
+ */
+static inline void list_del(struct list_head* node)
+{
+    node->next->prev = node->prev;
+    node->prev->next = node->next;
+    node->next = NULL;
+    node->prev = NULL;
+}
+static inline void list_del_init(struct list_head* node)
+{
+    node->next->prev = node->prev;
+    node->prev->next = node->next;
+    INIT_LIST_HEAD(node);
+}
+/*
+ * list_move_tail
+ *  DESCRIPTION : moves node from its list to the end of another one
+ *  INPUT       : node -- node to move
+ *                head -- list to move it to
+ *  OUTPUTS     : none
+ *  RETURN VALUE: none
+ *  SIDE EFFECTS: none
+ */
+static inline void list_move_tail(struct list_head* node, struct list_head* head)
+{
+    node->next->prev = node->prev;
+    node->prev->next = node->next;
+    list_add_tail(node, head);
+}
+/*
+ * list_empty
+ *  DESCRIPTION : checks whether a list has no entries
+ *  INPUT       : head -- list to check
+ *  OUTPUTS     : none
+ *  RETURN VALUE: 1 if empty, 0 otherwise
+ *  SIDE EFFECTS: none
+ */
+static inline int32_t list_empty(const struct list_head* head)
+{
+    return head->next == head;
+}
+/*
+ * list_splice_tail_init
+ *  DESCRIPTION : moves every entry of list to the end of head in one step
+ *  INPUT       : list -- list to empty
+ *                head -- list to append to
+ *  OUTPUTS     : none
+ *  RETURN VALUE: none
+ *  SIDE EFFECTS: list is left empty
+ */
+static inline void list_splice_tail_init(struct list_head* list, struct list_head* head)
+{
+    struct list_head* first = list->next;
+    struct list_head* last  = list->prev;
+    if (list_empty(list))
+	return;
+    first->prev      = head->prev;
+    head->prev->next = first;
+    last->next       = head;
+    head->prev       = last;
+    INIT_LIST_HEAD(list);
+}
+#endif
@@ -24,6 +24,4 @@ extern void *get_phys_addr(uint32_t virt_addr);
 extern void* __vm_alloc_list_entry();
 extern void  __vm_free_list_entry(void* addr);
 extern void init_vm_slab();
-extern void* ll_alloc();
-extern void  ll_free(void* addr);
 #endif
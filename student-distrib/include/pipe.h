@@ -0,0 +1,39 @@
+#ifndef PIPE_H
+#define PIPE_H
+#include "types.h"
+#include "wait.h"
+#include "sys_call.h"
+#define PIPE_BUF_SIZE   4096 // power of two, head and tail wrap with a mask
+#define PIPE_BUF_MASK   (PIPE_BUF_SIZE - 1)
+#define MAX_PIPES       8
+#define PIPE_READ_END   0
+#define PIPE_WRITE_END  1
+
+/* unidirectional byte stream between two file descriptors. head and tail
+ * run freely and are masked on access, head - tail is the number of bytes
+ * buffered. A pipe lives as long as one of its ends is referenced. */
+struct pipe {
+    uint8_t      buf[PIPE_BUF_SIZE];
+    uint32_t     head;      /* next byte written */
+    uint32_t     tail;      /* next byte read    */
+    int32_t      readers;   /* references to the read end  */
+    int32_t      writers;   /* references to the write end */
+    wait_queue_t read_wq;   /* readers waiting for data or the last writer */
+    wait_queue_t write_wq;  /* writers waiting for room or the last reader */
+    uint8_t      in_use;
+};
+typedef struct pipe pipe_t;
+
+struct fs_io;
+extern io_table_t pipe_read_ops;
+extern io_table_t pipe_write_ops;
+extern pipe_t* pipe_create();  /* new pipe, the caller holds one reference to each end */
+extern void pipe_get(pipe_t* p, int32_t end);
+extern void pipe_put(pipe_t* p, int32_t end); /* frees the pipe with its last reference */
+extern void pipe_attach(struct fs_io* file, pipe_t* p, int32_t end); /* hand a reference to a file */
+extern void pipe_release(struct fs_io* file);   /* drop the reference of a file, if any */
+extern int32_t pipe_do_read(pipe_t* p, uint8_t* buf, uint32_t len);
+extern int32_t pipe_do_write(pipe_t* p, const uint8_t* buf, uint32_t len);
+extern int32_t kernel_pipe();  /* sys call 19 */
+extern int32_t pipe(int32_t* fds);
+#endif
@@ -5,7 +5,12 @@
 #define PIT_CMD_PORT      0x43
 #define PIT_LO_HI_PORT    0x40
 #define PIT_IRQ           0x00
+#define PIT_INPUT_HZ      1193182 // PIT input clock, 3579545 / 3
 #define PIT_INIT_CMD      0x36 // This initialize channels zero, sets it to lo/hi config, and sets it to square wave
+#define PIT_ONESHOT_CMD   0x30 // Channel zero, lo/hi config, mode 0 (interrupt on terminal count)
+#define PIT_LATCH_CMD     0x00 // Latch channel zero's count so it can be read
+#define PIT_MAX_COUNT     0xFFFF // Largest 16 bit reload, about 55ms
+#define NO_TIMER_DEADLINE 0xFFFFFFFF // No timer within reach of one PIT count, arm PIT_MAX_COUNT
 #define RELOAD_VALUE      29830 // this sets it to aprox 25ms = (RELOAD_VALUE) * 3000 / 3579545
 #define WAIT_1               1
 #define END_1               10
@@ -13,13 +18,21 @@
 #define END_2               20
 #define WAIT_3              21
 #define END_3               30
+#define BOOT_TICKS_PER_TERM 10 // a base shell is attached every 10 ticks at boot
+#define USER_RPL          0x03 // privilege level bits of a ring 3 selector
 
 
 // 0xE90B // 59659 This sets the effectve time between interrupts to 50ms aprox
 // Equation for time between interrupts
 // time in ms = reload_value / (3579545 / 3) * 1000
-extern void pit_handler();
+extern void pit_handler(uint32_t cs); /* cs of the interrupted code, pushed by pit_linkage */
 extern volatile uint32_t PIT_tick;
+extern volatile uint32_t jiffies;   /* number of RELOAD_VALUE periods since boot */
+extern uint8_t tick_stopped;        /* set while the periodic tick is off in idle */
+extern uint32_t next_timer_deadline(); /* ticks until the next timer needs the PIT */
+extern void tick_nohz_enter();      /* stop the periodic tick before idling */
+extern int32_t tick_nohz_expired(); /* continue or end the idle sleep on a one-shot */
+extern void tick_nohz_exit();       /* restart the periodic tick */
 extern void init_pit();
 extern void pit_linkage();
 #endif
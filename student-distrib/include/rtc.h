@@ -7,6 +7,7 @@
 #include "lib.h"
 #include "x86_desc.h"
 #include "i8259.h"
+#include "wait.h"
 
 #define RTC_INTERRUPT_VEC 0x28
 #define RTC_INDEX_REG     0x70
@@ -27,6 +28,7 @@ struct rtc {
     uint32_t frequency;
 };
 typedef struct rtc rtc_t;
+extern wait_queue_t rtc_wq;
 /*Initializes the RTC*/
 extern void rtc_init();
 
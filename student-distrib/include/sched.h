@@ -5,15 +5,39 @@
 #include "terminal.h"
 #include "vga.h"
 #include "lib.h"
+#include "spinlock.h"
 #define NUM_REAL_TIME_P     100
 #define NUM_REGULAR_P       40
 #define MAX_NUM_P           NUM_REAL_TIME_P+NUM_REGULAR_P
+/* priority list index for each priority class (lower index runs first). The
+ * lists below RT_PL belong to the SCHED_FIFO/SCHED_RR tasks. */
+#define RT_PRIO_INDEX          (RT_PL)
+#define INTERACTIVE_PRIO_INDEX (RT_PL + BATCH_PL/4)
+#define REGULAR_PRIO_INDEX     (RT_PL + BATCH_PL/2)
+#define WAKE_BOOST_INDEX       (RT_PL + 1)  /* task just woken by keyboard input */
+#define FG_BOOST               (BATCH_PL/8) /* lists gained by tasks of the terminal on screen */
+/* timeslice bounds in PIT ticks, interpolated linearly over the priority range */
+#define MIN_TIMESLICE       1
+#define MAX_TIMESLICE       8
+#define MAX_PIDS_IN_BITMAP  32 /* pids tracked by pid_htable.bitmap */
+#define EFLAGS_RESERVED     0x00000002 /* bit 1 of EFLAGS always reads as 1 */
+#define EFLAGS_IF           0x00000200 /* interrupt enable flag */
+#define RR_TIMESLICE        4 /* PIT ticks a SCHED_RR task runs before the next one of its priority */
+#define RT_PERIOD_TICKS     40 /* real time bandwidth period, 1s of 25ms ticks */
+#define RT_RUNTIME_DEFAULT  38 /* real time ticks per period, leaves 5% to normal tasks */
+#define RT_RUNTIME_INF      (-1) /* sched_rt_runtime value that disables throttling */
+#define rt_policy(pol)      ((pol) == SCHED_FIFO || (pol) == SCHED_RR)
+#define rt_prio(idx)        ((idx) < RT_PL) /* priority list index of a real time task */
 /* runqueue structure */
 struct runqueue {
-    uint8_t  lock;       /* the lock   */
+    spinlock_t lock;     /* protects the arrays and counters below */
     uint32_t n_runnable; /* # runnable */
+    uint8_t  need_resched; /* set when current task should be preempted */
     uint32_t n_switches; /* # switches */
-    uint32_t timestamp;
+    uint32_t timestamp;  /* jiffies at the last context switch */
+    uint32_t ticks;      /* scheduler ticks so far */
+    uint32_t rt_time;    /* ticks used by real time tasks in the current period */
+    uint8_t  rt_throttled; /* real time budget used up, only normal tasks run */
     proc_t* current_pcb;
     proc_t* idle_pcb;
     prio_array_t* active_array;  /* pointer to active array */
@@ -22,8 +46,45 @@ struct runqueue {
     prio_array_t  second_array;  /* actual data for second priority array*/
 };
 typedef struct runqueue runqueue_t;
+
+/* per task accounting handed to user space by getrusage */
+struct rusage {
+    int32_t  pid;
+    uint8_t  state;
+    uint8_t  prio;
+    uint8_t  command[CMD_NAME_MAX_LEN];
+    uint32_t utime_ms;   /* time charged in user mode */
+    uint32_t stime_ms;   /* time charged in kernel mode */
+    uint32_t exec_ms;    /* measured time on the CPU */
+    uint32_t wait_ms;    /* time runnable but not running */
+    uint32_t nvcsw;      /* voluntary context switches */
+    uint32_t nivcsw;     /* involuntary context switches */
+    uint32_t syscalls;   /* system calls made */
+    uint32_t syscall_us; /* time spent in them */
+};
+typedef struct rusage rusage_t;
 extern runqueue_t runqueue;
+extern uint32_t nr_tasks;              /* live user processes, runnable or not */
+extern int32_t sched_rt_runtime;       /* real time ticks per RT_PERIOD_TICKS, RT_RUNTIME_INF for no limit */
 extern void init_runqueue(); /* initialize runqueue */
-extern int32_t switch_task(list_head_t* node); /* perform task switching */
+extern int32_t switch_task(proc_t* next); /* perform task switching */
+extern void switch_to(proc_t* prev, proc_t* next); /* swap kernel stacks, sched_asm.S */
+extern void ret_to_user();              /* first return address of a new task, sched_asm.S */
+extern void init_task_context(proc_t* p, uint32_t entry); /* build the first kernel stack of a task */
+extern void init_kthread_context(proc_t* p, void (*fn)(uint32_t), uint32_t data); /* same for a kernel thread */
+extern uint32_t vga_live_term;          /* terminal whose cursor state is loaded in the VGA globals */
+extern void save_live_tty();            /* store the VGA globals into vga_live_term's session */
+extern void load_live_tty();            /* reload the VGA globals from vga_live_term's session */
+extern void activate_task(proc_t* p);   /* make a task runnable */
+extern void deactivate_task(proc_t* p); /* remove a task from the runqueue */
+extern int32_t sched_setscheduler(proc_t* p, uint8_t policy, uint8_t rt_priority); /* change policy */
+extern void scheduler_tick();           /* charge current task one tick */
+extern void account_tick(uint32_t user); /* charge the tick to user or kernel time */
+extern void account_switch(proc_t* prev, proc_t* next); /* update switch and wait accounting */
+extern void init_task_stats(proc_t* p); /* clear the accounting of a new task */
+extern int32_t fill_rusage(proc_t* p, rusage_t* ru); /* snapshot a task's accounting */
+extern void show_task_stats();          /* top-like dump of every task */
+extern int32_t schedule();              /* pick and switch to the next task */
+extern void cpu_idle();                 /* halt until the next interrupt */
 extern proc_t* current_proc;
 #endif
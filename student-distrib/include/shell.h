@@ -8,5 +8,6 @@
 #include "terminal.h"
 extern void* init_shell(); /* initialize a shell instance */
 extern void* attach_shell(uint32_t term_id); /* initialize a shell instance and attach it a tty session */
-//extern queue_t* current_queue;
+extern int32_t is_pipeline(const uint8_t* cmd);
+extern int32_t run_pipeline(uint8_t* command, int32_t terminal, int32_t background); /* "a | b" for execute and spawn */
 #endif
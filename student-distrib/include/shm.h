@@ -0,0 +1,45 @@
+#ifndef SHM_H
+#define SHM_H
+#include "types.h"
+/* shared memory window, after the vDSO page in the table that also maps
+ * the vidmap page (USER_VIDEO_MEM_ADDR) */
+#define USER_SHM_ADDR       0x08C10000
+#define SHM_WINDOW_PAGES    64         // 256KB of user addresses
+#define SHM_NR_FRAMES       64         // 4KB frames backing every segment
+#define SHM_MAX_SEGMENTS    8
+#define SHM_MAX_PAGES       16         // 64KB per segment
+#define SHM_MAPS_PER_PROC   4
+#define SHM_NAME_LEN        16
+
+/* named segment, alive while a process maps it. A segment nobody has
+ * mapped yet stays until its first mapping goes away. */
+struct shm_segment {
+    int8_t   name[SHM_NAME_LEN];
+    uint32_t npages;
+    uint8_t  frames[SHM_MAX_PAGES];   /* indices into the frame pool */
+    int32_t  nattach;                 /* mappings in all processes */
+    uint8_t  in_use;
+};
+typedef struct shm_segment shm_segment_t;
+
+/* one segment mapped by a process, kept in its pcb */
+struct shm_map {
+    shm_segment_t* seg;               /* NULL for a free slot */
+    uint32_t       addr;              /* user address of the first page */
+};
+typedef struct shm_map shm_map_t;
+
+struct process_control_block;
+extern void shm_switch(struct process_control_block* next); /* install the mappings of next */
+extern void shm_exit(struct process_control_block* p);      /* unmap every segment of p */
+extern int32_t shm_get(const int8_t* name, uint32_t size); /* segment id */
+extern int32_t shm_attach(struct process_control_block* p, int32_t id, uint32_t addr); /* user address */
+extern int32_t shm_detach(struct process_control_block* p, uint32_t addr);
+extern int32_t shm_frame_refs(uint32_t addr);  /* references to the frame of a user address, for tests */
+extern int32_t kernel_shmget();   /* sys call 20 */
+extern int32_t kernel_shmat();    /* sys call 21 */
+extern int32_t kernel_shmdt();    /* sys call 22 */
+extern int32_t shmget(const uint8_t* name, uint32_t size);
+extern void*   shmat(int32_t id, void* addr);
+extern int32_t shmdt(void* addr);
+#endif
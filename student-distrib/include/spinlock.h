@@ -0,0 +1,70 @@
+#ifndef SPINLOCK_H
+#define SPINLOCK_H
+#include "types.h"
+#include "lib.h"
+/* define to record hold times and contention of every spinlock, shown on F3 */
+//#define LOCK_DEBUG
+#define TICKET_SHIFT        16
+#define TICKET_NEXT_INC     (1 << TICKET_SHIFT)
+#define TICKET_OWNER(v)     ((v) & 0xFFFF)
+#define TICKET_NEXT(v)      ((v) >> TICKET_SHIFT)
+
+/* ticket spinlock: waiters take a number from the upper half and are served
+ * in order as the holder bumps the lower half on unlock */
+struct spinlock {
+    volatile uint32_t slock;     /* next ticket << 16 | ticket being served */
+#ifdef LOCK_DEBUG
+    const int8_t* name;
+    int32_t  owner;              /* pid of the holder, -1 when free */
+    uint8_t  registered;         /* on the lock_debug_list */
+    uint32_t n_acquired;
+    uint32_t n_contended;        /* acquisitions that had to wait */
+    uint64_t acquired_at;        /* TSC when the holder got it */
+    uint64_t hold_max;           /* longest hold in cycles */
+    uint64_t hold_total;         /* sum of all holds in cycles */
+    struct spinlock* debug_next;
+#endif
+};
+typedef struct spinlock spinlock_t;
+
+/* helper macros to statically define an unlocked spinlock */
+#ifdef LOCK_DEBUG
+#define SPIN_LOCK_UNLOCKED(lname)   { 0, #lname, -1, 0, 0, 0, 0, 0, 0, NULL }
+#else
+#define SPIN_LOCK_UNLOCKED(lname)   { 0 }
+#endif
+#define DEFINE_SPINLOCK(lname)	    \
+    spinlock_t lname = SPIN_LOCK_UNLOCKED(lname)
+
+/*
+ * spin_lock_irqsave
+ *  DESCRIPTION:  takes a lock that is also taken from interrupt handlers,
+ *                keeping interrupts off on this CPU while it is held
+ *  INPUTS:       lock -- lock to take
+ *                flags -- variable receiving EFLAGS
+ *  OUTPUTS:      flags
+ *  RETURN VALUE: none
+ *  SIDE EFFECTS: disables interrupts and preemption
+ */
+#define spin_lock_irqsave(lock, flags)	    \
+do {					    \
+    cli_and_save(flags);		    \
+    spin_lock(lock);			    \
+} while (0)
+
+extern void spin_lock_init(spinlock_t* lock, const int8_t* name); /* unlocked, named for LOCK_DEBUG */
+extern void spin_lock(spinlock_t* lock);      /* take lock, preemption stays off until unlock */
+extern void spin_unlock(spinlock_t* lock);    /* release lock, may reschedule */
+extern int32_t spin_trylock(spinlock_t* lock); /* 1 if taken, 0 if it is held */
+extern void spin_unlock_irqrestore(spinlock_t* lock, uint32_t flags); /* undo spin_lock_irqsave */
+extern int32_t spin_is_locked(spinlock_t* lock);
+extern void _raw_spin_lock(spinlock_t* lock);   /* without touching the preempt count */
+extern void _raw_spin_unlock(spinlock_t* lock);
+extern int32_t _raw_spin_trylock(spinlock_t* lock);
+extern int32_t preempt_count;                 /* spinlocks held, no task switch while nonzero */
+extern void preempt_disable();                /* no task switch until preempt_enable */
+extern void preempt_enable();                 /* runs a reschedule that was held off */
+extern void preempt_enable_no_resched();      /* for paths that leave the kernel right after */
+extern int32_t preemptible();                 /* may an interrupt handler call schedule */
+extern void show_lock_stats();                /* LOCK_DEBUG table of every lock taken so far */
+#endif
@@ -10,6 +10,7 @@
 #define __8MB__			    0x00800000
 #define PCB_MASK		    0xFFFFE000
 #define MAX_PROCESSES		    8
+#define WNOHANG			    0x1 // waitpid returns 0 instead of blocking
 /*
  * PHYS_ADDR_START
  *  DESCRIPTION:  physcial address corresponding to pid number
@@ -33,6 +34,11 @@
 #define USER_STACK_ADDR		    ((0x08400000) - (0x4))
 #define USER_VIDEO_MEM_ADDR	    0x08C00000
 #define USER_VIDEO_MEM_OFFSET_MASK  0x0FF00000
+#define USER_VSYSCALL_ADDR	    (USER_VIDEO_MEM_ADDR + __4KB__) // system call stub page, read-only to user space
+#define MSR_SYSENTER_CS		    0x174
+#define MSR_SYSENTER_ESP	    0x175
+#define MSR_SYSENTER_EIP	    0x176
+#define CPUID_FEAT_SEP		    0x800 // EDX bit 11 of cpuid leaf 1
 /*
  * KERNEL_STACK_ADDR
  *  DESCRIPTION: starting address for kernel stack determined by pid
@@ -84,6 +90,14 @@
 	    :"g"(entry), "g"(USER_DS), "g"(USER_STACK_ADDR), "g"(USER_CS) \
 	    :"cc","memory","%eax"					       \
 	    );
+#define MULTICALL_MAX		    16 // entries one multicall may run
+/* one system call of a multicall batch */
+struct multicall_entry {
+    int32_t nr;
+    int32_t args[3];  /* ebx, ecx, edx of the call */
+    int32_t result;   /* filled in once the call ran */
+};
+typedef struct multicall_entry multicall_t;
 typedef int32_t (*f_ptr)(int32_t, uint8_t*, uint32_t);
 struct io_ops_table {
     f_ptr open;
@@ -99,6 +113,9 @@ extern io_table_t term_ops_table;
 
 /*Inititializes sys calls*/
 extern void init_sys_call();
+extern void sysenter_init();     /* stub page and SYSENTER MSRs of the BSP */
+extern uint8_t sysenter_enabled; /* the stub page enters through sysenter */
+extern uint8_t vsyscall_page[];  /* contents of the stub page */
 
 /* User sys_calls*/
 extern int32_t halt(uint8_t status);
@@ -116,15 +133,37 @@ extern int32_t kernel_read();
 extern int32_t kernel_write();
 extern int32_t kernel_open();
 extern int32_t kernel_close();
+extern int32_t kernel_gettime();
+extern int32_t kernel_sleep();
+extern int32_t kernel_getrusage();
+extern int32_t kernel_waitpid();
+extern int32_t kernel_setscheduler();
+extern int32_t kernel_null();
+extern int32_t kernel_multicall();
+extern int32_t kernel_spawn();
+struct pipe;
+extern int32_t do_execute(uint8_t* command, int32_t terminal, int32_t background,
+			  struct pipe* in, struct pipe* out); /* loader behind execute and spawn */
+extern int32_t do_sys_call(int32_t nr, int32_t arg1, int32_t arg2, int32_t arg3); /* handler nr with ebx, ecx, edx */
+extern int32_t wait_child(int32_t pid, int32_t* status, int32_t options); /* waitpid for the current process */
 extern int32_t getargs(uint8_t* buf, int32_t nbytes);
 extern int32_t vidmap(uint8_t** screen_start);
+extern int32_t gettime(void* ts);
+extern int32_t sleep(uint32_t ms);
+extern int32_t getrusage(int32_t pid, void* ru);
+extern int32_t waitpid(int32_t pid, int32_t* status, int32_t options);
+extern int32_t setscheduler(int32_t pid, int32_t policy, int32_t rt_priority);
+extern int32_t nullcall();
+extern int32_t multicall(multicall_t* calls, int32_t count);
+extern int32_t spawn(const uint8_t* command, int32_t terminal);
 // extern int32_t set_handler(int32_t signum, void* handler_address);
 // extern int32_t sigreturn(void);
 extern int32_t sys_call_vector();
+extern void sysenter_entry();
+/* stub page contents, copied by sysenter_init */
+extern uint8_t vsyscall_int80[], vsyscall_int80_end[];
+extern uint8_t vsyscall_sysenter[], vsyscall_sysenter_end[];
 /*Fills and IDT entry*/
 extern void fill_interrupt(int num, uint32_t* offset, uint16_t seg, uint16_t flags);
 
-/*Function checks if its a ELF file*/
-extern int32_t check_elf(uint8_t* file_name);
-
 #endif
@@ -0,0 +1,31 @@
+#ifndef SYSCALL_STAT_H
+#define SYSCALL_STAT_H
+#include "types.h"
+#define NR_SYS_CALLS          24 // MAX_SYS_CALL of sys_call_asm.S, entry 0 is unused
+#define SYS_HALT              1
+#define SYS_EXECUTE           2
+#define SYS_NULL              16
+#define SYS_MULTICALL         18
+#define SYS_SPAWN             23
+#define SYSCALL_HIST_BUCKETS  32 // log2 of the cycle count, 2^31 and up share the last one
+
+/* counters of one system call, handed to user space by sysstat. Latency is
+ * measured in TSC cycles from the entry of sys_call_vector to the return
+ * of the handler. halt never returns and is not
+ * counted, a blocking execute covers the whole life of the child. */
+struct syscall_stat {
+    uint32_t count;
+    uint32_t failed;                      /* calls that returned -1 */
+    uint64_t cycles;                      /* sum over all calls */
+    uint64_t max_cycles;
+    uint32_t hist[SYSCALL_HIST_BUCKETS];  /* hist[i] counts calls of 2^i to 2^(i+1)-1 cycles */
+};
+typedef struct syscall_stat syscall_stat_t;
+
+extern syscall_stat_t syscall_stats[NR_SYS_CALLS];
+extern void syscall_stat_exit(int32_t nr, int32_t ret, uint64_t start); /* called by sys_call_vector */
+extern void syscall_stat_add(int32_t nr, int32_t ret, uint64_t cycles); /* counters only, for calls inside multicall */
+extern int32_t kernel_sysstat();       /* sys call 17 */
+extern int32_t sysstat(int32_t nr, syscall_stat_t* buf);
+extern void show_syscall_stats();      /* F3 table of the calls made so far */
+#endif
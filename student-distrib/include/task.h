@@ -4,6 +4,8 @@
 #include "x86_desc.h"
 #include "sys.h"
 #include "fs.h"
+#include "fpu.h"
+#include "shm.h"
 #define KERNEL_PID		          0
 #define CMD_NAME_MAX_LEN	      32
 #define CMD_ARGS_MAX_LEN	      1024
@@ -12,6 +14,11 @@
 #define REAL_TIME_PRIO		      1
 #define INTERACTIVE_PRIO	      2
 #define REGULAR_PRIO		        3
+/* scheduling policies, the real time ones preempt every SCHED_NORMAL task */
+#define SCHED_NORMAL            0
+#define SCHED_FIFO              1 // runs until it blocks, no timeslice
+#define SCHED_RR                2 // round robin among tasks of equal rt_priority
+#define RT_MAX_PRIO             99
 #define MAX_PIDS                256
 #define P_SUCCESS		            0
 #define P_FAIL			            -1
@@ -61,8 +68,15 @@ enum task_state_t{
     TASK_STOPPED         = 0x08,
     TASK_ZOMBIE          = 0x10
 };
+/* kernel context saved by switch_to (sched_asm.S hardcodes these offsets) */
+struct thread_struct {
+    uint32_t esp;                   /* kernel ESP at the last switch_to, callee-saved regs on top */
+    uint32_t esp0;                  /* top of the kernel stack, loaded into tss.esp0 by switch_to */
+};
+typedef struct thread_struct thread_t;
 /* PCB structure */
 struct process_control_block {
+    thread_t thread;                /* must stay the first member, see switch_to */
     file_table_t* open_files;
     regs_t user_regs;               /* to save/restore user registers and context   */
     regs_t kernel_regs;             /* to save/restore kernel registers and context */
@@ -80,7 +94,32 @@ struct process_control_block {
     uint8_t  state;
     uint8_t  priority;
     uint8_t  is_vidmapped;		  /* flag whether process has vidmapping */
+    shm_map_t shm_maps[SHM_MAPS_PER_PROC]; /* shared memory segments the process maps */
+    uint8_t  background;                  /* parent kept running, exits as a zombie until waitpid */
+    int32_t  exit_status;                 /* halt status kept for waitpid while a zombie */
     int32_t  rtc_freq;          /* current rtc_freq the rtc read is running at*/
+    list_head_t run_list;       /* link in the runqueue priority list */
+    list_head_t tty_list;       /* link in the terminal's process chain */
+    list_head_t wait_list;      /* link in the wait queue the task sleeps on */
+    struct prio_array* array;   /* priority array the task is queued on, NULL when not runnable */
+    uint8_t  prio;              /* index into prio_array_t tasks, derived from priority */
+    uint8_t  policy;            /* SCHED_NORMAL, SCHED_FIFO or SCHED_RR */
+    uint8_t  wake_boost;        /* woken by keyboard input, cleared when it blocks or its slice ends */
+    uint8_t  rt_priority;       /* 1..RT_MAX_PRIO for the real time policies, higher runs first */
+    uint32_t time_slice;        /* PIT ticks left in the current timeslice */
+    uint8_t  is_kthread;        /* kernel thread, runs without a user address space */
+    uint32_t utime;             /* PIT ticks that interrupted this task in user mode */
+    uint32_t stime;             /* PIT ticks that interrupted this task in kernel mode */
+    uint32_t nvcsw;             /* voluntary context switches, task blocked */
+    uint32_t nivcsw;            /* involuntary context switches, task preempted */
+    uint64_t sum_exec_ns;       /* time spent on the CPU */
+    uint64_t wait_ns;           /* time spent runnable but waiting for the CPU */
+    uint64_t exec_start;        /* clock_ns when the task last got the CPU */
+    uint64_t wait_start;        /* clock_ns when the task last became runnable */
+    uint32_t nsyscalls;         /* system calls that returned */
+    uint64_t syscall_cycles;    /* TSC cycles spent in them */
+    uint8_t  used_math;         /* fpu holds a saved image, set on the first #NM */
+    fxsave_t fpu;               /* FPU/SSE registers while another task owns the FPU */
 };
 typedef struct process_control_block proc_t;
 //Struct for a task
@@ -100,14 +139,12 @@ typedef struct process_control_block proc_t;
 typedef struct pid_htable_entry {
     int16_t pid;
     proc_t	   pcb;
-    list_head_t* node;
 } pid_t;
 
 typedef struct pid_hash_struct{
     pid_t pids[MAX_PIDS];
     uint32_t bitmap;
 } pid_htable_t;
-extern queue_t* current_queue;
 extern pid_htable_t pid_htable;
 //extern proc_t* current_proc;
 /* Used at boot time to create sentinel task */
@@ -131,4 +168,6 @@ extern int32_t is_valid_elf_header(uint8_t* elf_data); /* check if file data is
 extern volatile int16_t next_pid ; /* next available pid  */
 extern volatile int16_t curr_pid ; /* pid of current task */
 extern void  close_proc(proc_t* proc); /* close the process and free system resources from its PCB */
+extern void  exit_proc(proc_t* proc);  /* release files and FPU, the pid stays reserved */
+extern void  release_proc(proc_t* proc); /* free the pid of a process done with exit_proc */
 #endif
@@ -6,6 +6,7 @@
 #include "vga.h"
 #include "sys_call.h"
 #include "sys.h"
+#include "wait.h"
 #define TERMINAL_BUF_SIZE     128
 #define MAX_NUM_TERMINALS       3
 #define ASCII_BACKSPACE      0x08
@@ -46,7 +47,8 @@ struct terminal_session {
     uint32_t    enter ;    // Whether or not enter was pressed
     uint32_t    id    ;
     vga_t	vga   ;
-    queue_t*    queue ;
+    struct list_head* queue; // Processes on this terminal, base shell first and foreground last
+    wait_queue_t* read_wq; // Readers sleeping until enter is pressed
     io_table_t* op_ptr;
 } __attribute__((packed));
 
@@ -73,6 +75,11 @@ extern terminal_session_t* getCurrentSession();
 /*session struct*/
 extern terminal_session_t sessions[MAX_NUM_TERMINALS];
 extern uint8_t session_buffers[MAX_NUM_TERMINALS][TERMINAL_BUF_SIZE];
+extern struct list_head term_queues[MAX_NUM_TERMINALS];
+extern wait_queue_t term_read_wqs[MAX_NUM_TERMINALS];
+
+/*Screen, VGA globals and line buffers, shared by writers and the keyboard worker*/
+extern spinlock_t tty_lock;
 
 extern int32_t save_term_vga_state();
 extern int32_t restore_term_vga_state();
@@ -3,10 +3,15 @@
 
 #include "types.h"
 
+#define SYSCALL_BENCH_ITERS 1000 // null calls per loop of sysbench_user
+
+#ifndef ASM
 // test launcher
 void launch_tests();
 
 extern void invalid_opcode();
 extern void sys_call(uint32_t num);
+extern uint8_t sysbench_user[], sysbench_user_end[]; /* ring 3 code, copied into the benchmark task */
+#endif /* ASM */
 
 #endif /* TESTS_H */
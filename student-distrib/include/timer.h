@@ -0,0 +1,41 @@
+#ifndef TIMER_H
+#define TIMER_H
+#include "types.h"
+#include "wait.h"
+/* hierarchical timer wheel: a 256 slot root level for the next 256 ticks,
+ * then four 64 slot levels each covering 64 times the previous span */
+#define TVR_BITS            8
+#define TVN_BITS            6
+#define TVR_SIZE            (1 << TVR_BITS)
+#define TVN_SIZE            (1 << TVN_BITS)
+#define TVR_MASK            (TVR_SIZE - 1)
+#define TVN_MASK            (TVN_SIZE - 1)
+#define NUM_TVN             4
+/* index of a timer in level n (n >= 1) of the wheel */
+#define TVN_INDEX(expires, n)	    \
+    (((expires) >> (TVR_BITS + ((n) - 1) * TVN_BITS)) & TVN_MASK)
+/* wrap-safe comparison of tick counts */
+#define time_after_eq(a, b)	    ((int32_t)((a) - (b)) >= 0)
+
+typedef void (*timer_fn_t)(uint32_t data);
+/* pending timer, linked into one wheel bucket */
+struct timer_list {
+    struct timer_list*  next;
+    struct timer_list*  prev;
+    struct timer_list** bucket;   /* head of the bucket holding it, NULL if not pending */
+    uint32_t            expires;  /* jiffies value to fire at */
+    timer_fn_t          function; /* called from the events worker */
+    uint32_t            data;     /* argument for function */
+};
+typedef struct timer_list timer_list_t;
+
+extern void init_timers();                   /* start the wheel at the current jiffies */
+extern void init_timer(timer_list_t* timer); /* mark a timer as not pending */
+extern void add_timer(timer_list_t* timer);  /* arm a timer, O(1) */
+extern int32_t del_timer(timer_list_t* timer); /* cancel a timer, O(1) */
+extern void run_timers();                    /* fire expired timers, run by the events worker */
+extern int32_t timer_pending_work();         /* from the PIT irq, 1 if run_timers has work */
+extern uint32_t timer_next_expiry(uint32_t max_ticks); /* ticks to the next expiry */
+extern uint32_t ms_to_jiffies(uint32_t ms);  /* round a ms interval up to ticks */
+extern int32_t sleep_ticks(uint32_t ticks);  /* block the current task for ticks */
+#endif
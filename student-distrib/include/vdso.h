@@ -0,0 +1,58 @@
+#ifndef VDSO_H
+#define VDSO_H
+#include "types.h"
+/* data page read by user space without a trap, mapped read-only
+ * right after the system call stub page (USER_VSYSCALL_ADDR + 4KB) */
+#define USER_VDSO_DATA_ADDR     0x08C02000
+#define VDSO_TEXT_OFFSET        0x200      // vdso_text inside the stub page
+/* offsets of the fields of vdso_data_t, shared with vdso_asm.S */
+#define VDSO_PID                0
+#define VDSO_TERMINAL           4
+#define VDSO_JIFFIES            8
+#define VDSO_TICK_NSEC          12
+#define VDSO_TSC_KHZ            16
+#define VDSO_CLOCK_MULT         20
+#define VDSO_CLOCK_SHIFT        24
+#define VDSO_TSC_BASE           32
+/* offsets of the user functions inside vdso_text */
+#define VDSO_GETPID_OFFSET      0x00
+#define VDSO_GETTERMINAL_OFFSET 0x10
+#define VDSO_GETTICKS_OFFSET    0x20
+#define VDSO_CLOCK_NS_OFFSET    0x30
+#define VDSO_GETTIME_OFFSET     0xC0
+
+#ifndef ASM
+struct timespec;
+/* Every field is one aligned word written with a single store, either by
+ * a task switch while the reader is switched out, or by the tick. A reader
+ * never sees half an update. */
+struct vdso_data {
+    int32_t  pid;          /* current task */
+    int32_t  terminal_id;
+    uint32_t jiffies;      /* PIT ticks since boot */
+    uint32_t tick_nsec;    /* length of a tick, the clock without a TSC */
+    uint32_t tsc_khz;      /* 0 if there is no TSC */
+    uint32_t clock_mult;   /* ns = (tsc - tsc_base) * clock_mult >> clock_shift */
+    uint32_t clock_shift;
+    uint32_t reserved;
+    uint64_t tsc_base;
+};
+typedef struct vdso_data vdso_data_t;
+
+/* addresses of the user functions, for programs linked against the page */
+#define VDSO_FN(off)        (USER_VSYSCALL_ADDR + VDSO_TEXT_OFFSET + (off))
+#define vdso_getpid         ((int32_t (*)())VDSO_FN(VDSO_GETPID_OFFSET))
+#define vdso_getterminal    ((int32_t (*)())VDSO_FN(VDSO_GETTERMINAL_OFFSET))
+#define vdso_getticks       ((uint32_t (*)())VDSO_FN(VDSO_GETTICKS_OFFSET))
+#define vdso_clock_ns       ((uint64_t (*)())VDSO_FN(VDSO_CLOCK_NS_OFFSET))
+#define vdso_gettime        ((int32_t (*)(struct timespec*))VDSO_FN(VDSO_GETTIME_OFFSET))
+
+struct process_control_block;
+extern void vdso_init();       /* clock parameters, user functions and the data page */
+extern void vdso_set_task(struct process_control_block* p); /* p is now current */
+extern void vdso_tick();       /* publish jiffies */
+/* vdso_asm.S, copied into the stub page by vdso_init */
+extern uint8_t vdso_text[];
+extern uint8_t vdso_text_end[];
+#endif /* ASM */
+#endif
@@ -0,0 +1,45 @@
+#ifndef WAIT_H
+#define WAIT_H
+#include "types.h"
+#include "list.h"
+#include "lib.h"
+#include "spinlock.h"
+/* wait queue: tasks sleeping until an event, linked through the
+ * wait_list node of each sleeper's process control block */
+struct wait_queue {
+    struct list_head  task_list;
+    spinlock_t        lock;  /* taken with interrupts off, wake_up runs in interrupt handlers */
+};
+typedef struct wait_queue wait_queue_t;
+
+/* helper macros to statically initialize or define an empty wait queue */
+#define __WAIT_QUEUE_INITIALIZER(name)	    \
+    { LIST_HEAD_INIT((name).task_list), SPIN_LOCK_UNLOCKED(name) }
+#define DECLARE_WAIT_QUEUE(name)	    \
+    wait_queue_t name = __WAIT_QUEUE_INITIALIZER(name)
+
+/*
+ * wait_event
+ *  DESCRIPTION:  sleeps on a wait queue until condition becomes true
+ *  INPUTS:       wq -- wait queue the waker calls wake_up on
+ *                condition -- expression re-evaluated after every wake up
+ *  OUTPUTS:      none
+ *  RETURN VALUE: none
+ *  SIDE EFFECTS: condition is tested with interrupts off so a wake up
+ *                between the test and the sleep cannot be lost
+ */
+#define wait_event(wq, condition)		    \
+do {						    \
+    uint32_t __wait_flags;			    \
+    cli_and_save(__wait_flags);			    \
+    while (!(condition))			    \
+	sleep_on(&(wq));			    \
+    restore_flags(__wait_flags);		    \
+} while (0)
+
+extern void init_waitqueue(wait_queue_t* wq); /* initialize an empty wait queue */
+extern void sleep_on(wait_queue_t* wq);       /* block current task, interrupts must be off */
+extern void wake_up(wait_queue_t* wq);        /* make every sleeper runnable again */
+extern void wake_up_interactive(wait_queue_t* wq); /* same, boosted for keyboard input */
+extern int32_t waitqueue_active(wait_queue_t* wq); /* check for sleepers */
+#endif
@@ -0,0 +1,34 @@
+#ifndef WORKQUEUE_H
+#define WORKQUEUE_H
+#include "types.h"
+#include "wait.h"
+/* deferred work: interrupt handlers only capture their data and queue a
+ * work item, a kernel thread runs the rest with interrupts enabled */
+typedef void (*work_fn_t)(uint32_t data);
+struct work_struct {
+    struct work_struct* next;
+    work_fn_t           func;    /* run by the worker thread */
+    uint32_t            data;    /* argument for func */
+    volatile uint8_t    pending; /* queued and not started yet */
+};
+typedef struct work_struct work_t;
+
+/* helper macro to statically define a work item */
+#define DECLARE_WORK(name, fn, arg)	    \
+    work_t name = { NULL, fn, arg, 0 }
+
+struct workqueue_struct {
+    work_t*       head;
+    work_t*       last;
+    spinlock_t    lock;          /* head and last, queue_work runs in interrupt handlers */
+    wait_queue_t  wait;          /* the worker sleeps here while the queue is empty */
+    struct process_control_block* worker;
+};
+typedef struct workqueue_struct workqueue_t;
+
+extern workqueue_t events_wq;    /* shared queue used by the interrupt handlers */
+extern int32_t init_workqueue(workqueue_t* wq, const int8_t* name, uint8_t priority); /* start a worker thread */
+extern void init_workqueues();   /* start the shared events worker */
+extern int32_t queue_work(workqueue_t* wq, work_t* work); /* 1 if queued, 0 if already pending */
+extern int32_t schedule_work(work_t* work); /* queue_work on events_wq */
+#endif
@@ -22,6 +22,11 @@
 #include "include/pit.h"
 #include "include/sched.h"
 #include "include/vga.h"
+#include "include/clock.h"
+#include "include/timer.h"
+#include "include/fpu.h"
+#include "include/vdso.h"
+#include "include/workqueue.h"
 #define RUN_TESTS  0
 
 /* Macros. */
@@ -153,6 +158,7 @@ void entry(unsigned long magic, unsigned long addr) {
 	//uint8_t outflow[TERMINAL_BUF_SIZE];
 	/* Init the IDT */
 	init_idt();
+	fpu_init(); // Enable SSE and take over #NM for lazy FPU switching
 	/* initialize IO table */
 	clear();
 	//splash_sonic();
@@ -164,6 +170,7 @@ void entry(unsigned long magic, unsigned long addr) {
 	 * PIC, any other initialization stuff... */
 	//printf("Initalizing Paging...\n");
 	paging_init();
+	sysenter_init(); // Map the system call stub page, fast entry through sysenter if the CPU has it
 	init_vga();
 	clear_all_terminals();
 	//printf("Initializing terminal driver...\n");
@@ -187,10 +194,14 @@ void entry(unsigned long magic, unsigned long addr) {
 	init_vm_slab();
 	init_runqueue();
 	init_idle_task();
+	init_workqueues(); // Worker thread for the deferred halves of the interrupt handlers
 	switch_terminals(0);
 	background = sessions[0].vga.bg;
 	foreground = sessions[0].vga.fg;
 	bg_fg_reset();
+	clock_init(); // Calibrate the TSC before the PIT tick starts
+	vdso_init(); // Publish the clock to user space, needs the calibration
+	init_timers();
 	init_pit(); // This starts the the process of initing all 3 terminal
 	/* Enable interrupts */
 	/* Do not enable the following until after you have set up your
@@ -210,6 +221,7 @@ void entry(unsigned long magic, unsigned long addr) {
 			vga_ctrl_L();
 			//launch_tests();
 		}
+		cpu_idle(); /* halt until there is something to do */
 		//files_ptr[0].sess->term_io[READ](0, getCurrentSession()->buffer, 0);
 		//getCurrentSession()->term_io[READ](0,outflow,0);
 		//getCurrentSession()->op_ptr->read(0,outflow,TERMINAL_BUF_SIZE);
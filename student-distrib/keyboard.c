@@ -4,6 +4,9 @@
 #include "include/keyboard.h"
 #include "include/terminal.h"
 #include "include/sched.h"
+#include "include/workqueue.h"
+#include "include/clock.h"
+#include "include/syscall_stat.h"
 
 // https://www.win.tue.nl/~aeb/linux/kbd/scancodes-11.html
 // http://www.philipstorr.id.au/pcbook/book3/scancode.htm
@@ -32,6 +35,19 @@ uint32_t activate_inter_flag    = 0;
 uint32_t keyboard_write         = 0;
 volatile uint32_t f2_key_flag   = 0;
 volatile uint32_t f3_key_flag   = 0;
+// Scan codes captured by the IRQ, drained by keyboard_bh
+static kbd_ring_t kbd_fifo;
+// Time keyboard_handler runs with interrupts off, up to the EOI
+static uint32_t kbd_irq_count = 0;
+static uint64_t kbd_irq_total = 0;
+static uint64_t kbd_irq_max   = 0;
+// Keystroke to echo latency, from the IRQ to the end of handle_scancode
+static uint32_t kbd_lat_count = 0;   /* key presses handled */
+static uint32_t kbd_lat_late  = 0;   /* of those, handled more than a tick after the IRQ */
+static uint64_t kbd_lat_max   = 0;
+static uint64_t kbd_lat_total = 0;
+static void keyboard_bh(uint32_t data);
+static DECLARE_WORK(keyboard_work, keyboard_bh, 0);
 /*
  * keyboard_init
  *   DESCRIPTION: initializes the keyboard with the IDT table and enables IRQ for keyboard
@@ -64,24 +80,149 @@ void keyboard_init()
     return;
 }
 
+terminal_session_t* current_term;
+static void handle_scancode(uint8_t keycode);
+static void show_input_latency();
 /*
- * keyboard_handler
- *   DESCRIPTION: reads the scan code in the keyboard register and deals with it
+ * show_stats_foreground
+ *   DESCRIPTION: prints the per task CPU accounting, the input latency, the
+ *                system call latencies and the lock statistics (F3) on the
+ *                foreground terminal, borrowing the VGA globals like the key
+ *                echo does
  *   INPUTS: none
+ *   OUTPUTS: the show_task_stats table
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: writes to video memory
+ */
+static void show_stats_foreground()
+{
+    save_live_tty();
+    restore_vga_state_NO_MEMORY(&sessions[current_session].vga);
+    vga_mem_base = VIDEO_MEM_START;
+    show_task_stats();
+    show_input_latency();
+    show_syscall_stats();
+    show_lock_stats(); /* empty unless built with LOCK_DEBUG */
+    save_vga_state_NO_MEMORY(&sessions[current_session].vga);
+    load_live_tty();
+}
+/*
+ * switch_foreground
+ *   DESCRIPTION: term_switch wrapper for the keyboard worker. term_switch
+ *                loads the colours and cursor of the new foreground
+ *                terminal, so the state of the terminal loaded in the VGA
+ *                globals is saved first and put back afterwards.
+ *   INPUTS: term - terminal to bring to the foreground
  *   OUTPUTS: none
  *   RETURN VALUE: none
- *   SIDE EFFECTS: deals with a keyboard interrupt
+ *   SIDE EFFECTS: see term_switch
  */
+static void switch_foreground(uint32_t term)
+{
+    save_live_tty();
+    term_switch(term);
+    load_live_tty();
+}
 
-terminal_session_t* current_term;
+/*
+ * keyboard_handler
+ *   DESCRIPTION: keyboard IRQ. Only pushes the raw scan code into kbd_fifo
+ *                and queues keyboard_work, the events worker does the rest.
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: drops the scan code if the fifo is full
+ */
 void keyboard_handler()
 {
-    cli();
+    uint64_t start = clock_ns();
+    uint64_t irq_ns;
+    kbd_ring_push(&kbd_fifo, inb(KEYBOARD_CMD_STAT_PORT), start);
+    schedule_work(&keyboard_work);
+    // Send EOI to the keyboard
+    send_eoi(KEYBOARD_IRQ);
+    irq_ns = clock_ns() - start;
+    kbd_irq_count += 1;
+    kbd_irq_total += irq_ns;
+    if (irq_ns > kbd_irq_max)
+	kbd_irq_max = irq_ns;
+    // Run the worker right away if it beats the current task
+    if (runqueue.need_resched && preemptible())
+	schedule();
+}
+
+/*
+ * keyboard_bh
+ *   DESCRIPTION: work function queued by keyboard_handler, the line
+ *                discipline. Drains kbd_fifo with interrupts on, the only
+ *                consumer of the ring.
+ *   INPUTS: data - unused
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: see handle_scancode
+ */
+static void keyboard_bh(uint32_t data)
+{
     uint8_t keycode;
+    uint64_t stamp, lat;
+    while (kbd_ring_pop(&kbd_fifo, &keycode, &stamp)) {
+	/* the screen and line buffer are shared with terminal_write */
+	spin_lock(&tty_lock);
+	handle_scancode(keycode);
+	if ((int8_t)keycode >= 0) { /* a press, releases echo nothing */
+	    lat = clock_ns() - stamp;
+	    kbd_lat_count += 1;
+	    kbd_lat_total += lat;
+	    if (lat > kbd_lat_max)
+		kbd_lat_max = lat;
+	    if (lat > TICK_NSEC)
+		kbd_lat_late += 1;
+	}
+	spin_unlock(&tty_lock);
+    }
+}
+
+/*
+ * show_input_latency
+ *   DESCRIPTION: prints the keystroke to echo latency measured by
+ *                keyboard_bh and the time spent in keyboard_handler, at the
+ *                current VGA position
+ *   INPUTS: none
+ *   OUTPUTS: two lines of statistics
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: caller holds tty_lock
+ */
+static void show_input_latency()
+{
+    uint64_t avg = kbd_lat_total;
+    uint64_t max = kbd_lat_max;
+    if (kbd_lat_count != 0)
+	div64_32(&avg, kbd_lat_count);
+    div64_32(&avg, NSEC_PER_USEC);
+    div64_32(&max, NSEC_PER_USEC);
+    vga_printf("keys %u  echo avg %u us  max %u us  over a tick %u\n", kbd_lat_count,
+	       (uint32_t)avg, (uint32_t)max, kbd_lat_late);
+    avg = kbd_irq_total;
+    if (kbd_irq_count != 0)
+	div64_32(&avg, kbd_irq_count);
+    vga_printf("irqs %u  irq avg %u ns  max %u ns  dropped %u\n", kbd_irq_count,
+	       (uint32_t)avg, (uint32_t)kbd_irq_max, kbd_fifo.dropped);
+}
+
+/*
+ * handle_scancode
+ *   DESCRIPTION: deals with one scan code: modifier flags, terminal switching,
+ *                echo and line buffer editing
+ *   INPUTS: keycode - scan code read from the keyboard
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: writes to the foreground terminal, must be called with interrupts off
+ */
+static void handle_scancode(uint8_t keycode)
+{
     uint8_t ascii_conversion;
     uint32_t i;
     key_t* entry;
-    keycode = inb(KEYBOARD_CMD_STAT_PORT);
     entry = (key_t*)key_press[keycode];
     if(keycode == ALTKEY)
 	alt_flag = 1;
@@ -101,24 +242,25 @@ void keyboard_handler()
 	caps_flag ^= 0x01;
     else if(keycode == F1KEY){ // Press F1 activates/deactivates the RTC interupt
 	if(alt_flag == 1) {
-	    term_switch(0); // Swtich to terminal 0
+	    switch_foreground(0); // Swtich to terminal 0
 	}
 	else
 	    activate_inter_flag ^= 0x01;
     }
     else if(keycode == F2KEY){ // Press F2 activates/deactivates something
 	if(alt_flag == 1) {
-	    term_switch(1); // Swtich to terminal 1
+	    switch_foreground(1); // Swtich to terminal 1
 	}
 	else
 	    f2_key_flag ^= 0x01;
     }
     else if(keycode == F3KEY){ // Press F3 to print the buffer
 	if(alt_flag == 1) {
-	    term_switch(2); // Swtich to terminal 2
+	    switch_foreground(2); // Swtich to terminal 2
 	}
 	else {
 	    f3_key_flag ^= 0x01;
+	    show_stats_foreground();
 	    //vga_printf("\nKeeb Buffer: %d\n", getCurrentSession()->index); code used to count how many char were in the current buffer
 	}
     }
@@ -135,16 +277,9 @@ void keyboard_handler()
 	if(keycode == ENTERKEY)
 	    ascii_conversion = '\n';
 	else if(keycode>MAX_KEY_PRESS)
-	{
-	    send_eoi(KEYBOARD_IRQ);
-	    sti();
 	    return;
-	}
-	else if(*(uint32_t*)entry == *(uint32_t*)unshow  && (keycode != BACKSPACEKEY)){
-	    send_eoi(KEYBOARD_IRQ);
-	    sti();
+	else if(*(uint32_t*)entry == *(uint32_t*)unshow  && (keycode != BACKSPACEKEY))
 	    return;
-	}
 	else if(shift_flag == 1 && caps_flag == 1)
 	    ascii_conversion = entry->shiftCapsChar;
 	else if(shift_flag == 1)
@@ -155,11 +290,9 @@ void keyboard_handler()
 	    ascii_conversion = entry->lowerChar;
 
 	current_term = getCurrentSession();
-	pid_t* hpid = get_current_htable_entry();
-	proc_t* current_pcb = &hpid->pcb;
 	if(current_term->en == 1)
 	{
-	    save_vga_state_NO_MEMORY(&sessions[current_pcb->terminal_id].vga);
+	    save_live_tty();
 	    restore_vga_state_NO_MEMORY(&sessions[current_session].vga);
 	    vga_mem_base = VIDEO_MEM_START;
 	    keyboard_write = 1;
@@ -199,6 +332,7 @@ void keyboard_handler()
 	    {
     		ascii_conversion = '\n';
     		current_term->enter = 1;
+    		wake_up_interactive(current_term->read_wq); /* wake the reader blocked in terminal_read */
     		current_term->buffer[(current_term->index)++] = ascii_conversion;
     		vga_putc(ascii_conversion);
 	    }
@@ -212,14 +346,7 @@ void keyboard_handler()
 
     	keyboard_write = 0;
     	save_vga_state_NO_MEMORY(&sessions[current_session].vga);
-    	restore_vga_state_NO_MEMORY(&sessions[current_pcb->terminal_id].vga);
-
-      vga_mem_base =(uint32_t) sessions[current_pcb->terminal_id].vga.screen_start;
-
+    	load_live_tty();
     }
-    // Send EOI to the keyboard
-    send_eoi(KEYBOARD_IRQ);
-    sti();
-    return;
 }
 #endif
@@ -0,0 +1,109 @@
+#ifndef KTHREAD_C
+#define KTHREAD_C
+#include "include/kthread.h"
+#include "include/sched.h"
+#include "include/lib.h"
+/*
+ * kthread_pid
+ *   DESCRIPTION: finds a free pid for a kernel thread, searching down from
+ *                KTHREAD_PID_MAX so user pids are not shifted
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: free pid, or -1 if the kernel thread range is full
+ *   SIDE EFFECTS: none
+ */
+static int16_t kthread_pid()
+{
+    int16_t pid;
+    for (pid = KTHREAD_PID_MAX; pid >= KTHREAD_PID_MIN; pid--) {
+	if ((pid_htable.bitmap & (1 << pid)) == 0)
+	    return pid;
+    }
+    return -1;
+}
+/*
+ * kthread_create
+ *   DESCRIPTION: makes a kernel thread and puts it on the runqueue. Kernel
+ *                threads run in ring 0 on their own kernel stack and have no
+ *                user address space, terminal or open files.
+ *   INPUTS: fn       -- function the thread runs, kthread_exit is called if it returns
+ *           data     -- argument passed to fn
+ *           name     -- shown in the pcb command field
+ *           priority -- scheduling class (REAL_TIME_PRIO, INTERACTIVE_PRIO, ...)
+ *   OUTPUTS: none
+ *   RETURN VALUE: pcb of the new thread, NULL on failure
+ *   SIDE EFFECTS: marks a pid as used
+ */
+proc_t* kthread_create(kthread_fn_t fn, uint32_t data, const int8_t* name, uint8_t priority)
+{
+    uint32_t flags;
+    int16_t pid;
+    pid_t* entry;
+    proc_t* p;
+    uint32_t len;
+    if (fn == NULL)
+	return NULL;
+    cli_and_save(flags);
+    pid = kthread_pid();
+    if (pid < 0) {
+	restore_flags(flags);
+	return NULL;
+    }
+    set_entry_by_index(pid_htable, pid);
+    entry = &pid_htable.pids[pid];
+    p     = &entry->pcb;
+    entry->pid  = pid;
+    INIT_LIST_HEAD(&p->tty_list);   /* not part of any terminal's process chain */
+    INIT_LIST_HEAD(&p->wait_list);
+    p->pid            = pid;
+    p->is_kthread     = 1;
+    p->parent         = NULL;
+    p->child          = NULL;
+    p->background     = 0;
+    p->policy         = SCHED_NORMAL;
+    p->wake_boost     = 0;
+    p->rt_priority    = 0;
+    p->open_files     = NULL;
+    p->file_table_num = 0;
+    p->num_open_files = 0;
+    p->terminal_id    = 0;
+    p->is_vidmapped   = 0;
+    p->entry_point    = (uint32_t)fn;
+    p->active         = 1;
+    p->priority       = priority;
+    p->used_math      = 0;
+    len = strlen(name);
+    if (len >= CMD_NAME_MAX_LEN)
+	len = CMD_NAME_MAX_LEN - 1;
+    memset((void*)p->command, 0, CMD_NAME_MAX_LEN);
+    memcpy((void*)p->command, (const void*)name, len);
+    init_task_stats(p);
+    init_kthread_context(p, fn, data);
+    activate_task(p);
+    restore_flags(flags);
+    return p;
+}
+/*
+ * kthread_exit
+ *   DESCRIPTION: ends the current kernel thread. The pid is released before
+ *                the final schedule, which is safe since nothing can reuse
+ *                the stack until interrupts are enabled again.
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: never returns
+ */
+void kthread_exit()
+{
+    proc_t* p = current_proc;
+    cli();
+    deactivate_task(p);
+    p->state      = TASK_STOPPED;
+    p->active     = 0;
+    p->is_kthread = 0;
+    fpu_release(p);
+    clear_entry_by_index(pid_htable, p->pid);
+    schedule();
+    while (1);
+}
+#endif
@@ -281,48 +281,4 @@ void __vm_free_list_entry(void* addr) {
     //__map_page((uint32_t)list_slab.page, (uint32_t)addr, 0);
 }
 
-/* ll_alloc
- *  DESCRIPTION:  allocates a region of memory in the slab for an list_head_t
- *                object.
- *  INPUTS:       none
- *  OUTPUTS:      none
- *  RETURN VALUE: a void pointer pointing to starting address in slab where object
- *                may be allocated to
- *  SIDE EFFECTS: adjusts vm_curr_obj_addr pointer to allocate memory to object
- */
-list_head_t allocations[32]; // 32 because uint32_t only has 32 bits
-volatile uint32_t allocations_bitmap = 0; // All allocations valid at the beginning
-void* ll_alloc()
-{
-    uint32_t temp_bitmap = allocations_bitmap;
-    int i = 0;
-    while( (temp_bitmap >> i++ & 0x01) != 0){}
-    allocations_bitmap |= (0x01 << (i-1)); // minus one is due to i++
-    return &(allocations[i-1]); // minus one is due to i++
-}
-
-/* ll_free
- *  DESCRIPTION:  reclaims a region of memory in the slab where a list_head_t
- *                object was previously allocated.
- *  INPUTS:       none
- *  OUTPUTS:      none
- *  RETURN VALUE: none
- *  SIDE EFFECTS: adjusts vm_curr_obj_addr pointer to reclaim memory previously
- *                allocated to object.
- */
-void ll_free(void* addr)
-{
-    if (addr == NULL)
-	return;
-    uint32_t i = 0;
-    for(;i<32;i++) // 32 because 32 bits in uint32_t
-    {
-	if(&allocations[i] == addr)
-	{
-	    allocations_bitmap &= ~(0x1 << i);
-	    return;
-	}
-    }
-    return;
-}
 #endif
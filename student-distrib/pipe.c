@@ -0,0 +1,244 @@
+#ifndef PIPE_C
+#define PIPE_C
+#include "include/pipe.h"
+#include "include/fs.h"
+#include "include/task.h"
+#include "include/sched.h"
+#include "include/lib.h"
+static pipe_t pipes[MAX_PIPES];
+/*
+ * pipe_create
+ *   DESCRIPTION: takes a free pipe from the pool and empties it
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: the pipe, NULL if every pipe is in use
+ *   SIDE EFFECTS: the caller owns one reference to each end and gives
+ *                 them away with pipe_attach or drops them with pipe_put
+ */
+pipe_t* pipe_create()
+{
+    int32_t i;
+    for (i = 0; i < MAX_PIPES; i++) {
+	pipe_t* p = &pipes[i];
+	if (p->in_use)
+	    continue;
+	p->in_use  = 1;
+	p->head    = 0;
+	p->tail    = 0;
+	p->readers = 1;
+	p->writers = 1;
+	init_waitqueue(&p->read_wq);
+	init_waitqueue(&p->write_wq);
+	return p;
+    }
+    return NULL;
+}
+/*
+ * pipe_get / pipe_put
+ *   DESCRIPTION: takes or drops a reference to one end of a pipe. Dropping
+ *                the last reader or writer wakes the other side, which then
+ *                sees a broken pipe or the end of the data.
+ *   INPUTS: p   -- pipe
+ *           end -- PIPE_READ_END or PIPE_WRITE_END
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: pipe_put returns the pipe to the pool with its last reference
+ */
+void pipe_get(pipe_t* p, int32_t end)
+{
+    if (p == NULL)
+	return;
+    if (end == PIPE_READ_END)
+	p->readers++;
+    else
+	p->writers++;
+}
+void pipe_put(pipe_t* p, int32_t end)
+{
+    if (p == NULL)
+	return;
+    if (end == PIPE_READ_END) {
+	if (--p->readers == 0)
+	    wake_up(&p->write_wq);
+    }
+    else {
+	if (--p->writers == 0)
+	    wake_up(&p->read_wq);
+    }
+    if (p->readers == 0 && p->writers == 0)
+	p->in_use = 0;
+}
+/*
+ * pipe_attach
+ *   DESCRIPTION: turns a file descriptor into one end of a pipe. The
+ *                reference the caller holds moves to the file.
+ *   INPUTS: file -- file descriptor entry to set up
+ *           p    -- pipe
+ *           end  -- PIPE_READ_END or PIPE_WRITE_END
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: replaces whatever the entry pointed to, without closing it
+ */
+void pipe_attach(fs_t* file, pipe_t* p, int32_t end)
+{
+    file->op_ptr    = (end == PIPE_READ_END) ? &pipe_read_ops : &pipe_write_ops;
+    file->pipe      = p;
+    file->buffer    = NULL;
+    file->sess      = NULL;
+    file->inode     = NULL;
+    file->inode_num = 0;
+    file->f_pos     = 0;
+    file->flags     = _OPEN;
+}
+/*
+ * pipe_release
+ *   DESCRIPTION: drops the reference a file descriptor holds to a pipe
+ *   INPUTS: file -- file descriptor entry
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: does nothing if the entry is not a pipe
+ */
+void pipe_release(fs_t* file)
+{
+    if (file == NULL || file->pipe == NULL)
+	return;
+    pipe_put(file->pipe, (file->op_ptr == &pipe_write_ops) ? PIPE_WRITE_END : PIPE_READ_END);
+    file->pipe   = NULL;
+    file->op_ptr = NULL;
+    file->flags  = _CLOSE;
+}
+/*
+ * pipe_do_read
+ *   DESCRIPTION: copies buffered bytes out of a pipe, sleeping while it is
+ *                empty and a writer is left
+ *   INPUTS: p   -- pipe
+ *           buf -- destination
+ *           len -- bytes wanted
+ *   OUTPUTS: buf
+ *   RETURN VALUE: bytes copied, 0 at the end of the data
+ *   SIDE EFFECTS: wakes writers waiting for room
+ */
+int32_t pipe_do_read(pipe_t* p, uint8_t* buf, uint32_t len)
+{
+    uint32_t n, first;
+    if (len == 0)
+	return 0;
+    wait_event(p->read_wq, p->head != p->tail || p->writers == 0);
+    n = p->head - p->tail;
+    if (n > len)
+	n = len;
+    /* at most two runs, up to the end of the buffer and from its start */
+    first = PIPE_BUF_SIZE - (p->tail & PIPE_BUF_MASK);
+    if (first > n)
+	first = n;
+    memcpy(buf, &p->buf[p->tail & PIPE_BUF_MASK], first);
+    memcpy(buf + first, p->buf, n - first);
+    p->tail += n;
+    if (n != 0)
+	wake_up(&p->write_wq);
+    return n;
+}
+/*
+ * pipe_do_write
+ *   DESCRIPTION: copies bytes into a pipe, sleeping whenever it is full
+ *                until everything is written or the last reader is gone
+ *   INPUTS: p   -- pipe
+ *           buf -- source
+ *           len -- bytes to write
+ *   OUTPUTS: none
+ *   RETURN VALUE: bytes written, -1 if the pipe has no reader left
+ *   SIDE EFFECTS: wakes readers waiting for data
+ */
+int32_t pipe_do_write(pipe_t* p, const uint8_t* buf, uint32_t len)
+{
+    uint32_t done = 0;
+    while (done < len) {
+	uint32_t n, first;
+	wait_event(p->write_wq, p->head - p->tail < PIPE_BUF_SIZE || p->readers == 0);
+	if (p->readers == 0)
+	    return (done != 0) ? (int32_t)done : -1;
+	n = PIPE_BUF_SIZE - (p->head - p->tail);
+	if (n > len - done)
+	    n = len - done;
+	first = PIPE_BUF_SIZE - (p->head & PIPE_BUF_MASK);
+	if (first > n)
+	    first = n;
+	memcpy(&p->buf[p->head & PIPE_BUF_MASK], buf + done, first);
+	memcpy(p->buf, buf + done + first, n - first);
+	p->head += n;
+	done    += n;
+	wake_up(&p->read_wq);
+    }
+    return done;
+}
+/*
+ * pipe_read / pipe_write / pipe_close
+ *   DESCRIPTION: file operations of the two ends of a pipe, reached through
+ *                kernel_read, kernel_write and kernel_close
+ *   INPUTS: fd     -- file descriptor of the current process
+ *           buffer -- user buffer
+ *           length -- bytes to transfer
+ *   OUTPUTS: none
+ *   RETURN VALUE: as pipe_do_read and pipe_do_write, 0 for close
+ *   SIDE EFFECTS: pipe_close frees the descriptor
+ */
+static int32_t pipe_read(int32_t fd, uint8_t* buffer, uint32_t length)
+{
+    return pipe_do_read(current_proc->open_files->files[fd].pipe, buffer, length);
+}
+static int32_t pipe_write(int32_t fd, uint8_t* buffer, uint32_t length)
+{
+    return pipe_do_write(current_proc->open_files->files[fd].pipe, buffer, length);
+}
+static int32_t pipe_close(int32_t fd, uint8_t* buffer, uint32_t length)
+{
+    file_table_t* files = current_proc->open_files;
+    pipe_release(&files->files[fd]);
+    files->bitmap &= ~(1 << fd);
+    return 0;
+}
+io_table_t pipe_read_ops  = { &invalid_func, &pipe_close, &pipe_read, &invalid_func };
+io_table_t pipe_write_ops = { &invalid_func, &pipe_close, &invalid_func, &pipe_write };
+/*
+ * kernel_pipe
+ *   DESCRIPTION: creates a pipe and opens both of its ends
+ *   INPUTS: fds - (ebx) user array, gets the read end in fds[0] and the
+ *                 write end in fds[1]
+ *   OUTPUTS: fds
+ *   RETURN VALUE: 0 on success, -1 on a bad pointer, if the process has no
+ *                 two free descriptors or no pipe is free
+ *   SIDE EFFECTS: none
+ */
+int32_t kernel_pipe()
+{
+    int32_t* fds;
+    asm ("			    \
+	    movl %%ebx, %0         ;\
+	    "
+	    :"=g"(fds)
+	    : /* no inputs */
+	    :"cc","memory"
+	);
+    file_table_t* files = current_proc->open_files;
+    int32_t index;
+    pipe_t* p;
+    if ((uint32_t)fds < START_OF_USER || (uint32_t)fds > (START_OF_USER + __4MB__ - 2 * sizeof(int32_t)))
+	return -1;
+    if (files == NULL)
+	return -1;
+    /* same placement as kernel_open, past the highest descriptor in use */
+    index = bitscan_reverse(files->bitmap) + 1;
+    if (index + 1 >= MAX_NUM_FD)
+	return -1;
+    p = pipe_create();
+    if (p == NULL)
+	return -1;
+    pipe_attach(&files->files[index], p, PIPE_READ_END);
+    pipe_attach(&files->files[index + 1], p, PIPE_WRITE_END);
+    files->bitmap |= (3 << index);
+    current_proc->num_open_files += 2;
+    fds[0] = index;
+    fds[1] = index + 1;
+    return 0;
+}
+#endif
@@ -9,23 +9,52 @@
 #include "include/sched.h"
 #include "include/task.h"
 #include "include/shell.h"
+#include "include/timer.h"
+#include "include/workqueue.h"
+#include "include/vdso.h"
 #define  PIT_FLAGS_MASK 0x8E00
 volatile uint32_t PIT_tick = 0;
-list_head_t* active_task[MAX_NUM_TERMINALS];
-volatile uint32_t cur_term_id = 2; // after staring terminals 0-2 you will be on terminal 2
+volatile uint32_t jiffies = 0;
+uint8_t tick_stopped = 0;
+static uint32_t nohz_reload;    /* PIT counts programmed for the idle one-shot */
+static uint32_t nohz_remainder; /* PIT counts not yet folded into jiffies */
 static regs_t regs;
+/*
+ *  timer_bh
+ *   DESCRIPTION: work function queued by pit_handler, fires expired timers
+ *   INPUTS: data - unused
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: see run_timers
+ */
+static void timer_bh(uint32_t data)
+{
+    run_timers();
+}
+static DECLARE_WORK(timer_work, timer_bh, 0);
 /*
  *  pit_handler
  *   DESCRIPTION: handles a pit interrupt
- *   INPUTS: none
+ *   INPUTS: cs - code segment of the interrupted context
  *   OUTPUTS: none
  *   RETURN VALUE: none
- *   SIDE EFFECTS: switches to next active task
+ *   SIDE EFFECTS: attaches the base shells at boot, afterwards preempts the
+ *                 running task through the O(1) scheduler
  */
-void pit_handler()
+void pit_handler(uint32_t cs)
 {
     regs_t regs_;
     memcpy(&regs_, &regs, sizeof(regs_t));
+    account_tick((cs & USER_RPL) == USER_RPL);
+    if (!tick_stopped)
+	jiffies += 1;
+    else if (tick_nohz_expired()) { /* idle one-shot ran out, but the idle sleep goes on */
+	send_eoi(PIT_IRQ);
+	return;
+    }
+    vdso_tick();
+    if (timer_pending_work()) /* timers are fired by the events worker */
+	schedule_work(&timer_work);
     // Give time for each terminal to run
     if( (PIT_tick >= WAIT_1 && PIT_tick <END_1) || (PIT_tick >= WAIT_2 && PIT_tick <END_2) || (PIT_tick >= WAIT_3 && PIT_tick <END_3))
       {
@@ -34,28 +63,153 @@ void pit_handler()
         return;
       }
     // Initializing terminals 0-2
-    if (PIT_tick >= 0 && PIT_tick < WAIT_3) {
-      if (sessions[PIT_tick].queue == NULL) {
-          send_eoi(PIT_IRQ);
-          attach_shell(PIT_tick % MAX_NUM_TERMINALS);
-      }
+    uint32_t term_id = PIT_tick / BOOT_TICKS_PER_TERM;
+    if (term_id < MAX_NUM_TERMINALS && sessions[term_id].queue == NULL && preemptible()) {
+	send_eoi(PIT_IRQ);
+	attach_shell(term_id);
+	return; /* the interrupted task resumes here once it is scheduled again */
     }
     cli();
-    // Set the active task to the head of each session
-    active_task[0] = sessions[0].queue->last; // Set active task for session 0 in active task array
-    active_task[1] = sessions[1].queue->last; // Set active task for session 1 in active task array
-    active_task[2] = sessions[2].queue->last; // Set active task for session 2 in active task array
-    cur_term_id = (current_proc->terminal_id + 1) ; // Go to next task
-    cur_term_id %= 3; /* want cur_term_id to be in range [0, 2] inclusive. */
-    if (active_task[cur_term_id] != NULL) {
-	switch_task(active_task[cur_term_id]);
-    }
+    /* charge the running task and preempt it if its timeslice ran out */
+    scheduler_tick();
     send_eoi(PIT_IRQ);
+    if (runqueue.need_resched && preemptible())
+	schedule();
 
     sti();
     asm volatile("leave; ret;");
 }
 
+/*
+ *  pit_program
+ *   DESCRIPTION: loads a mode and reload value into PIT channel zero
+ *   INPUTS: cmd - mode/command byte
+ *           reload - 16 bit reload value
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: restarts the channel zero count
+ */
+static void pit_program(uint8_t cmd, uint16_t reload)
+{
+    outb(cmd, PIT_CMD_PORT);
+    outb((reload & 0xFF), PIT_LO_HI_PORT); // Need bottom 8 bits
+    outb(((reload >> 8) & 0xFF), PIT_LO_HI_PORT); // Need top 8 bits
+}
+/*
+ *  next_timer_deadline
+ *   DESCRIPTION: reports how many ticks may pass before a kernel timer needs
+ *                the PIT again, looking only as far as one PIT count can reach
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: ticks until the next deadline, NO_TIMER_DEADLINE if none
+ *   SIDE EFFECTS: none
+ */
+uint32_t next_timer_deadline()
+{
+    return timer_next_expiry(PIT_MAX_COUNT / RELOAD_VALUE);
+}
+/*
+ *  nohz_arm
+ *   DESCRIPTION: programs the next one-shot of an idle sleep, as far towards
+ *                the timer deadline as the 16 bit count reaches
+ *   INPUTS: ticks - ticks until the next timer deadline
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: restarts the channel zero count
+ */
+static void nohz_arm(uint32_t ticks)
+{
+    uint32_t counts;
+    if (ticks > PIT_MAX_COUNT / RELOAD_VALUE) /* 16 bit counter caps one shot */
+	counts = PIT_MAX_COUNT;
+    else
+	counts = ticks * RELOAD_VALUE;
+    nohz_reload = counts;
+    pit_program(PIT_ONESHOT_CMD, (uint16_t)counts);
+}
+/*
+ *  nohz_account
+ *   DESCRIPTION: folds PIT counts that ran with the tick stopped into jiffies
+ *   INPUTS: counts - counts elapsed since the last fold
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: updates jiffies and the vDSO time
+ */
+static void nohz_account(uint32_t counts)
+{
+    nohz_remainder += counts;
+    jiffies        += nohz_remainder / RELOAD_VALUE;
+    nohz_remainder %= RELOAD_VALUE;
+    vdso_tick();
+}
+/*
+ *  tick_nohz_enter
+ *   DESCRIPTION: replaces the periodic tick with a chain of one-shot counts
+ *                reaching the next timer deadline. One count covers at most
+ *                PIT_MAX_COUNT (about 55ms), longer sleeps are continued
+ *                by tick_nohz_expired without leaving idle.
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: must be called with interrupts off from the idle task
+ */
+void tick_nohz_enter()
+{
+    uint32_t ticks = next_timer_deadline();
+    if (tick_stopped || ticks <= 1) /* the next periodic tick is needed anyway */
+	return;
+    nohz_arm(ticks);
+    tick_stopped = 1;
+}
+/*
+ *  tick_nohz_expired
+ *   DESCRIPTION: called by pit_handler when an idle one-shot ran out. Folds
+ *                it into jiffies and, while nothing became runnable and the
+ *                next timer is still more than a tick away, arms the next
+ *                one-shot of the chain. Otherwise goes back to periodic.
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: 1 if the idle sleep goes on, 0 if the tick was restarted
+ *   SIDE EFFECTS: must be called with interrupts off
+ */
+int32_t tick_nohz_expired()
+{
+    uint32_t ticks;
+    nohz_account(nohz_reload);
+    ticks = next_timer_deadline();
+    if (ticks > 1 && runqueue.n_runnable == 0 && !runqueue.need_resched) {
+	nohz_arm(ticks);
+	return 1;
+    }
+    pit_program(PIT_INIT_CMD, RELOAD_VALUE);
+    tick_stopped = 0;
+    return 0;
+}
+/*
+ *  tick_nohz_exit
+ *   DESCRIPTION: ends an idle sleep early, folds the part of the current
+ *                one-shot that already ran into jiffies and restarts the
+ *                periodic tick
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: must be called with interrupts off
+ */
+void tick_nohz_exit()
+{
+    uint32_t remaining;
+    if (!tick_stopped)
+	return;
+    outb(PIT_LATCH_CMD, PIT_CMD_PORT); /* see how far the count got */
+    remaining  = inb(PIT_LO_HI_PORT);
+    remaining |= inb(PIT_LO_HI_PORT) << 8;
+    if (remaining > nohz_reload)
+	remaining = 0;
+    nohz_account(nohz_reload - remaining);
+    pit_program(PIT_INIT_CMD, RELOAD_VALUE);
+    tick_stopped = 0;
+}
+
 /*
  *  init_pit
  *   DESCRIPTION: initializes the PIT and fills the IDT table for PIT
@@ -73,9 +227,7 @@ void init_pit()
 
     fill_interrupt(PIT_INTERRUPT_VEC,(uint32_t*)pit_linkage,segSize,flags);
 
-    outb(PIT_INIT_CMD,PIT_CMD_PORT);
-    outb((RELOAD_VALUE & 0xFF), PIT_LO_HI_PORT); // Need bottom 8 bits
-    outb((RELOAD_VALUE & 0xFF >> 8), PIT_LO_HI_PORT); // Need top 9 bits
+    pit_program(PIT_INIT_CMD, RELOAD_VALUE);
     enable_irq(PIT_IRQ);
     restore_flags(cliflags);
     return;
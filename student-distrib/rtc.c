@@ -11,8 +11,11 @@
 uint32_t ticks;
 uint32_t freq;
 int interrupt_;
+uint32_t rtc_wakeup_tick;      /* earliest tick a sleeping reader waits for */
+DECLARE_WAIT_QUEUE(rtc_wq);    /* readers blocked in rtc_read */
 int intr_count = 0;
 rtc_t rtc;
+static DEFINE_SPINLOCK(rtc_lock); /* CMOS index/data port pair */
 /*
  * rtc_init
  *   DESCRIPTION: initializes the RTC and fills the IDT table for RTC
@@ -62,18 +65,26 @@ void rtc_init()
 void rtc_handler()
 {
   // Read register C for what interrupt happened
-  cli();
-    outb(RTC_REG_C,RTC_INDEX_REG);
+  spin_lock(&rtc_lock);
+  outb(RTC_REG_C,RTC_INDEX_REG);
   inb(RTC_RW_REG);      //Need to read register C for next interrupt to happen
+  spin_unlock(&rtc_lock);
   intr_count++;
   interrupt_ = 1;
   ticks++;              // Increment the number of tick
+  // Only wake the readers once the earliest deadline among them is reached
+  if (waitqueue_active(&rtc_wq) && (int32_t)(ticks - rtc_wakeup_tick) >= 0)
+    wake_up(&rtc_wq);
+  // Nobody is waiting on a tick, mask the RTC so it does not wake an idle CPU
+  if (!waitqueue_active(&rtc_wq))
+    disable_irq(RTC_IRQ);
   // if(activate_inter_flag == 1) screen will flash if f1 is pressed
   //   test_interrupts();
   // // if(ticks%freq == 0)
   // //   printf("1Sec\n");
   send_eoi(RTC_IRQ);   // send eoi after servicing
-  sti();
+  if (runqueue.need_resched && preemptible())
+    schedule();
   return;
 }
 /*
@@ -108,12 +119,13 @@ void set_rtc_freq_default(uint32_t rate)
     rtc.frequency = freq;
     rate &= 0x0F;
 
-    cli();
+    uint32_t flags;
+    spin_lock_irqsave(&rtc_lock, flags);
     outb(RTC_REG_A, RTC_INDEX_REG);
     char prev = inb(RTC_RW_REG);
     outb(RTC_REG_A, RTC_INDEX_REG);
     outb((prev & 0xF0)|DEF_FREQ, RTC_RW_REG); // 0xF0 preserve the top 4 bits
-    sti();
+    spin_unlock_irqrestore(&rtc_lock, flags);
 
     return;
 }
@@ -136,12 +148,13 @@ void set_rtc_freq(uint32_t rate)
     //rtc.frequency = freq;
     rate &= 0x0F;
 
-    cli();
+    uint32_t flags;
+    spin_lock_irqsave(&rtc_lock, flags);
     outb(RTC_REG_A, RTC_INDEX_REG);
     char prev = inb(RTC_RW_REG);
     outb(RTC_REG_A, RTC_INDEX_REG);
     outb((prev & 0xF0)|rate, RTC_RW_REG); // 0xF0 preserve the top 4 bits
-    sti();
+    spin_unlock_irqrestore(&rtc_lock, flags);
 
     return;
 }
@@ -156,11 +169,10 @@ void set_rtc_freq(uint32_t rate)
  */
 
 int rtc_open(const uint8_t* filename) {
-    cli();
+    // Only the caller's own pcb is touched, no lock needed
     pid_t* hpid = get_current_htable_entry();
     proc_t* current_pcb = &hpid->pcb;
     current_pcb->rtc_freq = STARTING_FREQ; // Base freq is 2 htz
-    sti();
     return 0;
 }
 
@@ -173,12 +185,9 @@ int rtc_open(const uint8_t* filename) {
  *   SIDE EFFECTS: none (for now)
  */
 int rtc_close(int32_t fd) {
-    cli();
-
     pid_t* hpid = get_current_htable_entry();
     proc_t* current_pcb = &hpid->pcb;
     current_pcb->rtc_freq = 0;
-    sti();
     return 0;
 }
 
@@ -193,24 +202,17 @@ int rtc_close(int32_t fd) {
  *   SIDE EFFECTS: sets rtc frequency to any power of 2 within a range
  */
 int rtc_write(int32_t fd, const void* buf, int32_t nbytes) {
-    cli();
     if (CHECK_MSB(nbytes))
-    {
-       sti();
 	     return -1;
-    }
     int freq_ = *(int*)buf;
     uint32_t freq_t = freq_ - 1; /* check and make sure the */
-    if((freq_ & freq_t) != 0) {  /* freq passed in is a valid power of 2 */
-       sti();
+    if((freq_ & freq_t) != 0)    /* freq passed in is a valid power of 2 */
 	     return -1;
-    }
     rtc.frequency = freq_;
     pid_t* hpid = get_current_htable_entry();
     proc_t* current_pcb = &hpid->pcb;
     current_pcb->rtc_freq = freq_;
     //set_rtc_freq(DEF_FREQ); // Make sure that the freq is set to max
-    sti();
     return 0;
 }
 
@@ -223,7 +225,7 @@ int rtc_write(int32_t fd, const void* buf, int32_t nbytes) {
  *   OUTPUTS: int
  *   RETURN VALUE: '0' on success
  *   SIDE EFFECTS: only returns once enough interrupts have been received to give the illusion
- *   the rtc is operationg at the user frequency setting
+ *   the rtc is operationg at the user frequency setting. The caller sleeps on rtc_wq meanwhile.
  */
 int rtc_read(int32_t fd, void* buf, int32_t nbytes) {
     //set_rtc_freq(6); /* set max frequency, 1024 Hz */
@@ -231,12 +233,17 @@ int rtc_read(int32_t fd, void* buf, int32_t nbytes) {
 	   return -1;
     int freq_ = current_proc->rtc_freq;
     int count = BASE_FREQ / freq_; /* interrupts needed for user frequency*/
-    for(; count > 0; count--) { /* loop until enough interrupts have been received */
-    	while(interrupt_ == 0) {
-    	    continue;
-    	}
-    	interrupt_ = 0;
+    uint32_t flags;
+    uint32_t target;
+    cli_and_save(flags);
+    target = ticks + count;
+    while ((int32_t)(ticks - target) < 0) { /* sleep until enough interrupts have been received */
+	if (!waitqueue_active(&rtc_wq) || (int32_t)(target - rtc_wakeup_tick) < 0)
+	    rtc_wakeup_tick = target;
+	enable_irq(RTC_IRQ); /* rtc_handler masks the RTC while nobody waits */
+	sleep_on(&rtc_wq);
     }
+    restore_flags(flags);
     return 0;
 }
 
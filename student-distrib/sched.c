@@ -4,130 +4,768 @@
 #include "include/i8259.h"
 #include "include/memory.h"
 #include "include/terminal.h"
+#include "include/pit.h"
+#include "include/kthread.h"
+#include "include/clock.h"
+#include "include/vdso.h"
 runqueue_t runqueue;
 proc_t* current_proc = &(pid_htable.pids[0].pcb); // gets an empty pcb
+uint32_t nr_tasks = 0;
+uint32_t vga_live_term = 0;
+int32_t sched_rt_runtime = RT_RUNTIME_DEFAULT; /* RT ticks allowed per RT_PERIOD_TICKS, RT_RUNTIME_INF for no limit */
 /*
  *  init_runqueue
  *   DESCRIPTION: initializes the runqueue
  *   INPUTS: none
  *   OUTPUTS: none
  *   RETURN VALUE: none
- *   SIDE EFFECTS: switches to next active task
+ *   SIDE EFFECTS: empties both priority arrays and clears the current and
+ *                 idle task, does not switch
  */
 void init_runqueue()
 {
-    runqueue.lock          = 0;              /* default value */
-    runqueue.n_runnable    = 0;              /*      |        */
-    runqueue.n_switches    = 0;              /*      |        */
-    runqueue.timestamp     = 0;              /*      |        */
-    runqueue.current_pcb  = NULL;            /*      |        */
-    runqueue.idle_pcb     = NULL;            /*      |        */
-    runqueue.active_array  = NULL;           /*      |        */
-    runqueue.expired_array = NULL;           /*      |        */
-    runqueue.first_array.bitmap		= 0; /*      |        */
-    runqueue.second_array.bitmap	= 0; /*      V        */
-    runqueue.active_array		= &runqueue.first_array; /* active array points to first array */
-    runqueue.active_array->tasks->ops	= &queue_ops_table; /* queue operations are set */
-    runqueue.expired_array		= &runqueue.second_array; /* expired array points to second array */
-    runqueue.expired_array->tasks->ops	= &queue_ops_table; /* queue operations set */
-    queue_t* active			= runqueue.active_array->tasks;
-    queue_t* expired			= runqueue.expired_array->tasks;
-    list_head_t* start			= (list_head_t*)ll_alloc(); /* allocate a node */
-    LIST_HEAD(the_head);
-    *start				= the_head;
-    active->head			= start; /* point head/last nodes in queue to same node */
-    expired->head			= start;
-    active->last			= start;
-    expired->last			= start;
-
+    uint32_t i;
+    runqueue_t* rq = &runqueue;
+    nr_tasks = 0;
+    spin_lock_init(&rq->lock, (const int8_t*)"runqueue");
+    rq->n_runnable    = 0;              /*      |        */
+    rq->need_resched  = 0;              /*      |        */
+    rq->n_switches    = 0;              /*      |        */
+    rq->timestamp     = 0;              /*      |        */
+    rq->ticks         = 0;              /*      |        */
+    rq->current_pcb   = NULL;           /*      |        */
+    rq->idle_pcb      = NULL;           /*      V        */
+    rq->active_array		= &rq->first_array; /* active array points to first array */
+    rq->expired_array		= &rq->second_array; /* expired array points to second array */
+    rq->first_array.n_active	= 0;
+    rq->second_array.n_active	= 0;
+    rq->first_array.n_rt	= 0;
+    rq->second_array.n_rt	= 0;
+    rq->rt_time			= 0;
+    rq->rt_throttled		= 0;
+    for (i = 0; i < PRIO_BITMAP_SIZE; i++) { /* no priority list is populated yet */
+	rq->first_array.bitmap[i]	= 0;
+	rq->second_array.bitmap[i]	= 0;
+    }
+    for (i = 0; i < N_PL; i++) { /* empty priority lists */
+	INIT_LIST_HEAD(&rq->first_array.tasks[i]);
+	INIT_LIST_HEAD(&rq->second_array.tasks[i]);
+    }
 }
-proc_t* pcb;
 /*
- *  switch_task
- *   DESCRIPTION: switches to the task based on the node
- *   INPUTS: node - contains info of the next task to switch to
+ *  sched_find_first_bit
+ *   DESCRIPTION: finds the lowest set bit at or above start in a priority
+ *                bitmap
+ *   INPUTS: bitmap -- PRIO_BITMAP_SIZE words, bit i set when list i is non-empty
+ *           start -- first list to consider, RT_PL skips the real time lists
  *   OUTPUTS: none
- *   RETURN VALUE: -1 on fail and 0 on success
- *   SIDE EFFECTS: switches to next active task
+ *   RETURN VALUE: index of the highest priority non-empty list, -1 if none
+ *   SIDE EFFECTS: none
  */
-int32_t switch_task(list_head_t* node)
+static int32_t sched_find_first_bit(uint32_t* bitmap, uint32_t start)
 {
-    /* verify input and value of current pcb */
-    if (node == NULL || current_proc == NULL)
-	return -1;
-    /* check that process referred to by node is not null */
-    if (node->entry == NULL)
-	node = node->next;
-    /* cast to a pid_t type and extract the pcb */
-    pid_t* context = (pid_t*)node->entry;
-    if (context == NULL)
-	return -1;
-    pcb = &context->pcb;		   /* process to switch to */
-    if (pcb == NULL)
+    uint32_t i, pos, word;
+    for (i = start / 32; i < PRIO_BITMAP_SIZE; i++) {
+	word = bitmap[i];
+	if (i == start / 32)
+	    word &= ~((1 << (start % 32)) - 1);
+	if (word == 0)
+	    continue;
+	asm volatile("bsfl %1, %0":"=r"(pos):"rm"(word):"cc");
+	return (int32_t)(i * 32 + pos);
+    }
+    return -1;
+}
+/*
+ *  effective_prio
+ *   DESCRIPTION: maps a task's priority class onto a priority list index.
+ *                Normal tasks of the terminal on screen are boosted by
+ *                FG_BOOST lists, and a task woken by keyboard input runs
+ *                right below the events worker until its slice ends or it
+ *                blocks again, so a busy background terminal cannot make
+ *                typing lag.
+ *   INPUTS: p -- task to look at
+ *   OUTPUTS: none
+ *   RETURN VALUE: index into prio_array_t tasks
+ *   SIDE EFFECTS: none
+ */
+static uint8_t effective_prio(proc_t* p)
+{
+    uint8_t idx;
+    if (rt_policy(p->policy))
+	return RT_PL - 1 - p->rt_priority; /* rt_priority 1..RT_MAX_PRIO, higher runs first */
+    if (p->priority == REAL_TIME_PRIO)
+	return RT_PRIO_INDEX;
+    if (p->wake_boost)
+	return WAKE_BOOST_INDEX;
+    idx = (p->priority == INTERACTIVE_PRIO) ? INTERACTIVE_PRIO_INDEX : REGULAR_PRIO_INDEX;
+    if (!p->is_kthread && p->terminal_id == current_session)
+	idx -= FG_BOOST;
+    return idx;
+}
+/*
+ *  task_timeslice
+ *   DESCRIPTION: computes the length of a fresh timeslice for a task,
+ *                higher priority tasks get longer slices
+ *   INPUTS: p -- task to look at
+ *   OUTPUTS: none
+ *   RETURN VALUE: timeslice in PIT ticks
+ *   SIDE EFFECTS: none
+ */
+static uint32_t task_timeslice(proc_t* p)
+{
+    if (p->policy == SCHED_RR)
+	return RR_TIMESLICE;
+    return MIN_TIMESLICE + ((MAX_TIMESLICE - MIN_TIMESLICE) * (N_PL - 1 - p->prio)) / (N_PL - 1);
+}
+/*
+ *  enqueue_task
+ *   DESCRIPTION: appends a task to the tail of its priority list in an array
+ *   INPUTS: p -- task to queue
+ *           array -- priority array to queue it on
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: sets the bitmap bit for the task's priority
+ */
+static void enqueue_task(proc_t* p, prio_array_t* array)
+{
+    list_add_tail(&p->run_list, &array->tasks[p->prio]);
+    array->bitmap[p->prio / 32] |= (1 << (p->prio % 32));
+    array->n_active++;
+    if (rt_prio(p->prio))
+	array->n_rt++;
+    p->array = array;
+}
+/*
+ *  dequeue_task
+ *   DESCRIPTION: unlinks a task from its priority list
+ *   INPUTS: p -- task to unlink
+ *           array -- priority array the task is queued on
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: clears the bitmap bit once the priority list is empty
+ */
+static void dequeue_task(proc_t* p, prio_array_t* array)
+{
+    list_del_init(&p->run_list);
+    if (list_empty(&array->tasks[p->prio]))
+	array->bitmap[p->prio / 32] &= ~(1 << (p->prio % 32));
+    array->n_active--;
+    if (rt_prio(p->prio))
+	array->n_rt--;
+    p->array = NULL;
+}
+/*
+ *  check_preempt
+ *   DESCRIPTION: requests a reschedule when p beats the running task
+ *   INPUTS: rq -- runqueue p was just put on
+ *           p  -- newly runnable task
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: may set rq->need_resched
+ */
+static void check_preempt(runqueue_t* rq, proc_t* p)
+{
+    proc_t* curr = rq->current_pcb;
+    if (curr != NULL && curr != rq->idle_pcb && p->prio >= curr->prio)
+	return;
+    rq->need_resched = 1;
+}
+/*
+ *  activate_task
+ *   DESCRIPTION: puts a task on the active array so it is picked by schedule
+ *   INPUTS: p -- task to make runnable
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: updates n_runnable under the runqueue lock
+ */
+void activate_task(proc_t* p)
+{
+    uint32_t flags;
+    runqueue_t* rq = &runqueue;
+    if (p == NULL || p->pid == KERNEL_PID)
+	return;
+    spin_lock_irqsave(&rq->lock, flags);
+    if (p->array != NULL) {
+	spin_unlock_irqrestore(&rq->lock, flags);
+	return;
+    }
+    p->prio       = effective_prio(p);
+    p->time_slice = task_timeslice(p);
+    p->state      = TASK_RUNNING;
+    p->wait_start = clock_ns();
+    enqueue_task(p, rq->active_array);
+    rq->n_runnable += 1;
+    check_preempt(rq, p);
+    spin_unlock_irqrestore(&rq->lock, flags);
+}
+/*
+ *  deactivate_task
+ *   DESCRIPTION: removes a task from whichever array it is queued on
+ *   INPUTS: p -- task to remove
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: updates n_runnable under the runqueue lock
+ */
+void deactivate_task(proc_t* p)
+{
+    uint32_t flags;
+    runqueue_t* rq = &runqueue;
+    if (p == NULL)
+	return;
+    spin_lock_irqsave(&rq->lock, flags);
+    if (p->array != NULL) {
+	dequeue_task(p, p->array);
+	rq->n_runnable -= 1;
+    }
+    p->wake_boost = 0; /* blocking ends a keyboard boost */
+    spin_unlock_irqrestore(&rq->lock, flags);
+}
+/*
+ *  sched_setscheduler
+ *   DESCRIPTION: changes the scheduling policy of a task. A queued task is
+ *                moved to the list of its new priority in the active array.
+ *   INPUTS: p -- task to change
+ *           policy -- SCHED_NORMAL, SCHED_FIFO or SCHED_RR
+ *           rt_priority -- 1..RT_MAX_PRIO for the real time policies, 0 for SCHED_NORMAL
+ *   OUTPUTS: none
+ *   RETURN VALUE: 0 on success, -1 on a bad policy or priority
+ *   SIDE EFFECTS: may request a reschedule
+ */
+int32_t sched_setscheduler(proc_t* p, uint8_t policy, uint8_t rt_priority)
+{
+    uint32_t flags;
+    runqueue_t* rq = &runqueue;
+    prio_array_t* array;
+    if (p == NULL || p->pid == KERNEL_PID || policy > SCHED_RR)
 	return -1;
-    if (pcb->pid == KERNEL_PID) {
+    if (rt_policy(policy) ? (rt_priority < 1 || rt_priority > RT_MAX_PRIO) : (rt_priority != 0))
 	return -1;
+    spin_lock_irqsave(&rq->lock, flags);
+    array = p->array;
+    if (array != NULL)
+	dequeue_task(p, array);
+    p->policy      = policy;
+    p->rt_priority = rt_priority;
+    p->prio        = effective_prio(p);
+    p->time_slice  = task_timeslice(p);
+    if (array != NULL) {
+	enqueue_task(p, rq->active_array);
+	if (p != rq->current_pcb) {
+	    check_preempt(rq, p);
+	} else {
+	    rq->need_resched = 1; /* it may not be the best choice anymore */
+	}
     }
-    terminal_session_t* current_term = getCurrentSession();
-    /* If the terminal ID for this PCB is not the one showing then need to replace
-     * the virtual address of the video memory with the one corresponing to the
-     * terminal ID of the PCB
-     */
-
-    save_vga_state_NO_MEMORY(&(sessions[current_proc->terminal_id].vga));
-
-    restore_vga_state_NO_MEMORY(&(sessions[pcb->terminal_id].vga));
-
-    if(pcb->terminal_id != current_term->id)
-    {
-	vga_mem_base = (uint32_t)sessions[pcb->terminal_id].vga.screen_start;
+    spin_unlock_irqrestore(&rq->lock, flags);
+    return 0;
+}
+/*
+ *  rt_bandwidth_tick
+ *   DESCRIPTION: enforces sched_rt_runtime. Real time tasks may
+ *                use that many ticks of every RT_PERIOD_TICKS, after that
+ *                the runqueue is throttled and only normal tasks are picked
+ *                until the period ends, so a spinning FIFO task cannot lock
+ *                the system up.
+ *   INPUTS: p -- task the tick interrupted
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: may set runqueue.need_resched, runqueue lock must be held
+ */
+static void rt_bandwidth_tick(proc_t* p)
+{
+    runqueue_t* rq = &runqueue;
+    if (p != NULL && p->array != NULL && rt_policy(p->policy))
+	rq->rt_time += 1;
+    if (rq->ticks % RT_PERIOD_TICKS == 0) { /* new period, refill the budget */
+	rq->rt_time = 0;
+	if (rq->rt_throttled && rq->active_array->n_rt > 0)
+	    rq->need_resched = 1;
+	rq->rt_throttled = 0;
     }
+    if (!rq->rt_throttled && sched_rt_runtime != RT_RUNTIME_INF && rq->rt_time >= (uint32_t)sched_rt_runtime) {
+	rq->rt_throttled = 1;
+	if (rq->active_array->n_active > rq->active_array->n_rt || rq->expired_array->n_active > 0)
+	    rq->need_resched = 1; /* there is a normal task to give the rest of the period to */
+    }
+}
+/*
+ *  scheduler_tick
+ *   DESCRIPTION: charges the running task for one PIT tick. A task whose
+ *                timeslice runs out is moved to the expired array with a
+ *                fresh slice and a reschedule is requested. Real time tasks
+ *                never expire: SCHED_RR goes to the tail of its list in the
+ *                active array, SCHED_FIFO keeps the CPU until it blocks.
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: may set runqueue.need_resched
+ */
+void scheduler_tick()
+{
+    proc_t* p = current_proc;
+    runqueue.ticks += 1;
+    spin_lock(&runqueue.lock);
+    rt_bandwidth_tick(p);
+    spin_unlock(&runqueue.lock);
+    if (p == runqueue.idle_pcb || p->array == NULL) {
+	/* idle or a task that just blocked, run whatever became runnable */
+	if (runqueue.n_runnable > 0)
+	    runqueue.need_resched = 1;
+	return;
+    }
+    spin_lock(&runqueue.lock);
+    if (p->policy == SCHED_FIFO || p->array == NULL) {
+	spin_unlock(&runqueue.lock);
+	return;
+    }
+    if (p->time_slice > 0)
+	p->time_slice--;
+    if (p->time_slice == 0) {
+	dequeue_task(p, p->array);
+	p->wake_boost = 0;
+	p->prio       = effective_prio(p); /* pick up priority changes, e.g. from kernel_open or term_switch */
+	p->time_slice = task_timeslice(p);
+	if (rt_policy(p->policy))
+	    enqueue_task(p, runqueue.active_array); /* round robin among equal real time priorities */
+	else
+	    enqueue_task(p, runqueue.expired_array);
+	runqueue.need_resched = 1;
+    }
+    spin_unlock(&runqueue.lock);
+}
+/*
+ *  account_tick
+ *   DESCRIPTION: charges the current PIT tick to the running task, as user
+ *                time if the tick interrupted ring 3 and kernel time if not
+ *   INPUTS: user -- nonzero if the interrupted code ran in user mode
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: called from pit_handler with interrupts off
+ */
+void account_tick(uint32_t user)
+{
+    proc_t* p = current_proc;
+    if (p == NULL)
+	return;
+    if (user)
+	p->utime += 1;
     else
-    {
-      vga_mem_base = VIDEO_START_ADDR;
+	p->stime += 1;
+}
+/*
+ *  account_switch
+ *   DESCRIPTION: closes the CPU interval of prev and the wait interval of
+ *                next. A prev still on the runqueue was preempted, one that
+ *                left it blocked on its own.
+ *   INPUTS: prev -- task giving up the CPU
+ *           next -- task about to run
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: updates runqueue.timestamp
+ */
+void account_switch(proc_t* prev, proc_t* next)
+{
+    uint64_t now = clock_ns();
+    prev->sum_exec_ns += now - prev->exec_start;
+    if (prev->array != NULL) {
+	prev->nivcsw    += 1;
+	prev->wait_start = now;
+    } else {
+	prev->nvcsw += 1;
     }
-
-    // Changing vidmap based on if the process needs it or not
-    if (pcb->is_vidmapped == 1 && current_proc->is_vidmapped == 1) {
-      if(pcb->terminal_id == current_term->id)
-        __map_user_page(VIDEO_START_ADDR, USER_VIDEO_MEM_ADDR, PRESENT | RW_EN | USER_EN);
-      else
-        __map_user_page( (uint32_t)sessions[pcb->terminal_id].vga.screen_start, USER_VIDEO_MEM_ADDR, PRESENT | RW_EN | USER_EN);
-
-      flush_tlb();
+    if (next->array != NULL)
+	next->wait_ns += now - next->wait_start;
+    next->exec_start   = now;
+    runqueue.timestamp = jiffies;
+}
+/*
+ *  init_task_stats
+ *   DESCRIPTION: clears the accounting fields of a task that is being created
+ *   INPUTS: p -- new task
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+void init_task_stats(proc_t* p)
+{
+    if (p == NULL)
+	return;
+    p->utime       = 0;
+    p->stime       = 0;
+    p->nvcsw       = 0;
+    p->nivcsw      = 0;
+    p->sum_exec_ns = 0;
+    p->wait_ns     = 0;
+    p->nsyscalls   = 0;
+    p->syscall_cycles = 0;
+    p->exec_start  = clock_ns();
+    p->wait_start  = p->exec_start;
+}
+/*
+ *  ns_to_ms
+ *   DESCRIPTION: converts a 64 bit ns count to 32 bit ms
+ *   INPUTS: ns -- time in ns
+ *   OUTPUTS: none
+ *   RETURN VALUE: time in ms
+ *   SIDE EFFECTS: none
+ */
+static uint32_t ns_to_ms(uint64_t ns)
+{
+    div64_32(&ns, NSEC_PER_MSEC);
+    return (uint32_t)ns;
+}
+/*
+ *  fill_rusage
+ *   DESCRIPTION: snapshots the accounting of a task into an rusage_t. The
+ *                running task's current interval is included.
+ *   INPUTS: p  -- task to report
+ *           ru -- buffer to fill
+ *   OUTPUTS: ru
+ *   RETURN VALUE: 0 on success, -1 on a bad argument
+ *   SIDE EFFECTS: none
+ */
+int32_t fill_rusage(proc_t* p, rusage_t* ru)
+{
+    uint32_t flags;
+    uint64_t exec, wait, sys_ns;
+    if (p == NULL || ru == NULL)
+	return -1;
+    cli_and_save(flags);
+    exec = p->sum_exec_ns;
+    wait = p->wait_ns;
+    if (p == current_proc)
+	exec += clock_ns() - p->exec_start;
+    else if (p->array != NULL)
+	wait += clock_ns() - p->wait_start;
+    ru->pid      = p->pid;
+    ru->state    = p->state;
+    ru->prio     = p->prio;
+    memcpy((void*)ru->command, (const void*)p->command, CMD_NAME_MAX_LEN);
+    ru->utime_ms = ns_to_ms((uint64_t)p->utime * TICK_NSEC);
+    ru->stime_ms = ns_to_ms((uint64_t)p->stime * TICK_NSEC);
+    ru->exec_ms  = ns_to_ms(exec);
+    ru->wait_ms  = ns_to_ms(wait);
+    ru->nvcsw    = p->nvcsw;
+    ru->nivcsw   = p->nivcsw;
+    ru->syscalls = p->nsyscalls;
+    sys_ns       = cycles_to_ns(p->syscall_cycles);
+    div64_32(&sys_ns, NSEC_PER_USEC);
+    ru->syscall_us = (uint32_t)sys_ns;
+    restore_flags(flags);
+    return 0;
+}
+/*
+ *  show_task_stats
+ *   DESCRIPTION: top-like dump of the accounting of every live task,
+ *                printed at the current VGA position
+ *   INPUTS: none
+ *   OUTPUTS: one line per task
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: writes to the screen selected by vga_mem_base
+ */
+void show_task_stats()
+{
+    rusage_t ru;
+    int32_t pid;
+    vga_printf("\nswitches %u  runnable %u  tasks %u  last switch at tick %u\n",
+	       runqueue.n_switches, runqueue.n_runnable, nr_tasks, runqueue.timestamp);
+    vga_printf("PID  CMD       USR(ms)  SYS(ms)  RUN(ms)  WAIT(ms)  VCSW  IVCSW\n");
+    for (pid = 0; pid < MAX_PIDS_IN_BITMAP; pid++) {
+	if ((pid_htable.bitmap & (1 << pid)) == 0)
+	    continue;
+	if (fill_rusage(&pid_htable.pids[pid].pcb, &ru) != 0)
+	    continue;
+	vga_printf("%d  %s  %u  %u  %u  %u  %u  %u\n", ru.pid, (int8_t*)ru.command,
+		   ru.utime_ms, ru.stime_ms, ru.exec_ms, ru.wait_ms, ru.nvcsw, ru.nivcsw);
     }
-    else if (pcb->is_vidmapped == 0 && current_proc->is_vidmapped == 1) {
-        __map_user_page(VIDEO_START_ADDR, USER_VIDEO_MEM_ADDR, 0);
-        flush_tlb();
+}
+/*
+ *  swap_arrays
+ *   DESCRIPTION: makes the expired array the active one once every normal
+ *                task used up its timeslice. Real time tasks never expire,
+ *                their lists are spliced over to the new active array.
+ *   INPUTS: rq -- runqueue whose arrays to swap, locked
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+static void swap_arrays(runqueue_t* rq)
+{
+    prio_array_t* old = rq->active_array;
+    prio_array_t* new = rq->expired_array;
+    list_head_t* node;
+    int32_t idx;
+    rq->active_array  = new;
+    rq->expired_array = old;
+    while (old->n_rt > 0 && (idx = sched_find_first_bit(old->bitmap, 0)) >= 0 && rt_prio(idx)) {
+	list_for_each(node, &old->tasks[idx]) {
+	    list_entry(node, proc_t, run_list)->array = new;
+	    old->n_active--;
+	    old->n_rt--;
+	    new->n_active++;
+	    new->n_rt++;
+	}
+	list_splice_tail_init(&old->tasks[idx], &new->tasks[idx]);
+	old->bitmap[idx / 32] &= ~(1 << (idx % 32));
+	new->bitmap[idx / 32] |= (1 << (idx % 32));
     }
-    else if (pcb->is_vidmapped == 1 && current_proc->is_vidmapped == 0) {
-      if(pcb->terminal_id == current_term->id)
-        __map_user_page(VIDEO_START_ADDR, USER_VIDEO_MEM_ADDR, PRESENT | RW_EN | USER_EN);
-      else
-        __map_user_page((uint32_t)sessions[pcb->terminal_id].vga.screen_start, USER_VIDEO_MEM_ADDR, PRESENT | RW_EN | USER_EN);
-
-      flush_tlb();
+}
+/*
+ *  pick_next_task
+ *   DESCRIPTION: first task of the highest priority non-empty list of the
+ *                active array, swapping the active and expired arrays when
+ *                every normal task has used up its timeslice. The real time
+ *                lists are skipped while the runqueue is throttled.
+ *   INPUTS: rq -- the runqueue
+ *   OUTPUTS: none
+ *   RETURN VALUE: task to run, NULL if rq is empty
+ *   SIDE EFFECTS: interrupts must be off
+ */
+static proc_t* pick_next_task(runqueue_t* rq)
+{
+    prio_array_t* array;
+    proc_t* next = NULL;
+    int32_t idx;
+    spin_lock(&rq->lock);
+    array = rq->active_array;
+    if (array->n_active == array->n_rt && rq->expired_array->n_active > 0 && (array->n_rt == 0 || rq->rt_throttled)) {
+	swap_arrays(rq); /* no normal task left with a timeslice */
+	array = rq->active_array;
     }
-    else if (pcb->is_vidmapped == 0 && current_proc->is_vidmapped == 0) {
-	     // Do nothing
+    idx = sched_find_first_bit(array->bitmap, rq->rt_throttled ? RT_PL : 0);
+    if (idx >= 0)
+	next = list_first_entry(&array->tasks[idx], proc_t, run_list);
+    spin_unlock(&rq->lock);
+    return next;
+}
+/*
+ *  schedule
+ *   DESCRIPTION: switches to the task pick_next_task chose, or to the idle
+ *                task when the runqueue is empty. The runqueue lock is not
+ *                held across the switch itself.
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: 0 if no switch was needed, otherwise the result of switch_task
+ *   SIDE EFFECTS: must be called with interrupts off and no spinlock held
+ */
+int32_t schedule()
+{
+    proc_t* next;
+    runqueue.need_resched = 0;
+    next = pick_next_task(&runqueue);
+    if (next == NULL)
+	next = runqueue.idle_pcb;
+    if (next == NULL || next == current_proc)
+	return 0;
+    if (current_proc == runqueue.idle_pcb)
+	tick_nohz_exit(); /* leaving idle, the next task needs its periodic tick */
+    runqueue.n_switches += 1;
+    return switch_task(next);
+}
+/*
+ *  cpu_idle
+ *   DESCRIPTION: body of the idle task loop. Halts the CPU until the next
+ *                interrupt, stopping the periodic tick first once the base
+ *                shells are up and nothing is runnable. With the tick stopped
+ *                it keeps halting until the next timer deadline or until an
+ *                interrupt makes a task runnable.
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: returns with interrupts enabled
+ */
+void cpu_idle()
+{
+    cli();
+    if (runqueue.n_runnable == 0 && !runqueue.need_resched && PIT_tick >= END_3)
+	tick_nohz_enter();
+    do { /* one-shots chained by tick_nohz_expired need no trip through here */
+	asm volatile("sti; hlt;" ::: "memory"); /* sti holds off interrupts until hlt */
+	cli();
+    } while (tick_stopped && runqueue.n_runnable == 0 && !runqueue.need_resched);
+    tick_nohz_exit();
+    sti();
+}
+/*
+ *  live_tty_base
+ *   DESCRIPTION: picks the screen vga_live_term writes to, real video
+ *                memory for the foreground terminal, else its backing page
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: value for vga_mem_base
+ *   SIDE EFFECTS: none
+ */
+static uint32_t live_tty_base()
+{
+    if (vga_live_term == current_session)
+	return VIDEO_START_ADDR;
+    return (uint32_t)sessions[vga_live_term].vga.screen_start;
+}
+/*
+ *  save_live_tty / load_live_tty
+ *   DESCRIPTION: save the VGA globals into the terminal they belong to, or
+ *                load them back together with the matching vga_mem_base.
+ *                Used by code that borrows the VGA globals for another
+ *                terminal, like keyboard echo to the foreground.
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: modifies the VGA globals or the saved session state
+ */
+void save_live_tty()
+{
+    save_vga_state_NO_MEMORY(&(sessions[vga_live_term].vga));
+}
+void load_live_tty()
+{
+    restore_vga_state_NO_MEMORY(&(sessions[vga_live_term].vga));
+    vga_mem_base = live_tty_base();
+}
+/*
+ *  switch_tty
+ *   DESCRIPTION: moves the VGA cursor/colour state over to the terminal of
+ *                next and points vga_mem_base at its screen. The cursor is
+ *                only saved and restored when the terminal actually changes.
+ *                Kernel threads have no terminal and keep whatever is loaded.
+ *   INPUTS: next - task about to run
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: modifies vga_mem_base, vga_live_term and the VGA cursor
+ */
+static void switch_tty(proc_t* next)
+{
+    if (next->is_kthread)
+	return;
+    if (vga_live_term != next->terminal_id) {
+	save_live_tty();
+	vga_live_term = next->terminal_id;
+	load_live_tty();
+    } else {
+	vga_mem_base = live_tty_base(); /* the foreground may have changed */
     }
+}
+/*
+ *  switch_mm
+ *   DESCRIPTION: installs the user page, the vidmap page and the shared
+ *                memory segments of next. Each entry is only rewritten (and its TLB entry invalidated with
+ *                invlpg) when it differs from what is already mapped, so
+ *                switching between tasks that share a mapping costs nothing.
+ *   INPUTS: next - task about to run
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: modifies page_directory and user_pte
+ */
+static void switch_mm(proc_t* next)
+{
+    uint32_t* user_pde = &page_directory.directory_table[START_OF_USER >> PMD_SHIFT];
+    uint32_t* vid_pte  = &user_pte.pages[(USER_VIDEO_MEM_ADDR >> PAGE_BITSHIFT) & PAGE_TABLE_MAX_SIZE];
+    uint32_t want;
 
-    SAVE_ESP(current_proc->kernel_regs); /* save ESP and EBP */
-    SAVE_EBP(current_proc->kernel_regs);
-    uint32_t phys_addr = PHYS_ADDR_START(pcb->pid);
-    uint32_t virt_addr = START_OF_USER;
-    current_proc = pcb;                  /* update current proc pointer */
-    curr_pid     = pcb->pid;
-    runqueue.current_pcb = current_proc;
-    __map_page_directory(phys_addr, virt_addr, PRESENT | RW_EN | USER_EN | EXTENDED_PAGING); /* map address space of process to be scheduled */
-    flush_tlb();
-    tss.ss0   = KERNEL_DS;
-    tss.esp0 = KERNEL_STACK_ADDR(pcb->pid); /* update TSS fields */
-    RESTORE_ESP(pcb->kernel_regs); /* restore ESP and EBP */
-    RESTORE_EBP(pcb->kernel_regs);
-    current_proc = pcb;
-    curr_pid     = pcb->pid;
-    asm volatile("leave;\nret;");
+    if (next->is_kthread)   /* kernel threads run on whatever is mapped */
+	return;
+    if (next->pid != KERNEL_PID) { /* idle task has no user address space */
+	want = PHYS_ADDR_START(next->pid) | PRESENT | RW_EN | USER_EN | EXTENDED_PAGING;
+	if ((*user_pde & ~(ACCESSED | DIRTY)) != want) {
+	    *user_pde = want;
+	    flush_tlb_single(START_OF_USER);
+	}
+    }
+    /* a task without vidmap gets no user video page at all */
+    want = 0;
+    if (next->is_vidmapped) {
+	if (next->terminal_id == current_session)
+	    want = VIDEO_START_ADDR;
+	else
+	    want = (uint32_t)sessions[next->terminal_id].vga.screen_start;
+	want |= PRESENT | RW_EN | USER_EN;
+    }
+    if ((*vid_pte & ~(ACCESSED | DIRTY)) != want) {
+	*vid_pte = want;
+	flush_tlb_single(USER_VIDEO_MEM_ADDR);
+    }
+    shm_switch(next);
+}
+/*
+ *  init_task_context
+ *   DESCRIPTION: builds the kernel stack of a task that has never run so the
+ *                first switch_to into it returns through ret_to_user and
+ *                IRETs to entry in ring 3.
+ *   INPUTS: p     - pcb of the new task, pid must be assigned
+ *           entry - user space address to start executing at
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: writes the top of the task's kernel stack
+ */
+void init_task_context(proc_t* p, uint32_t entry)
+{
+    uint32_t* sp = (uint32_t*)KERNEL_STACK_ADDR(p->pid);
+    p->thread.esp0 = (uint32_t)sp;
+    *(--sp) = USER_DS;			/* IRET frame */
+    *(--sp) = USER_STACK_ADDR;
+    *(--sp) = EFLAGS_IF | EFLAGS_RESERVED;
+    *(--sp) = USER_CS;
+    *(--sp) = entry;
+    *(--sp) = (uint32_t)ret_to_user;	/* switch_to returns here */
+    *(--sp) = 0;			/* ebp */
+    *(--sp) = 0;			/* ebx */
+    *(--sp) = 0;			/* esi */
+    *(--sp) = 0;			/* edi */
+    p->thread.esp = (uint32_t)sp;
+}
+/*
+ *  init_kthread_context
+ *   DESCRIPTION: builds the kernel stack of a kernel thread so the first
+ *                switch_to into it lands in kthread_start, which calls
+ *                fn(data) with interrupts enabled
+ *   INPUTS: p    - pcb of the new thread, pid must be assigned
+ *           fn   - thread function
+ *           data - argument for fn
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: writes the top of the thread's kernel stack
+ */
+void init_kthread_context(proc_t* p, void (*fn)(uint32_t), uint32_t data)
+{
+    uint32_t* sp = (uint32_t*)KERNEL_STACK_ADDR(p->pid);
+    p->thread.esp0 = (uint32_t)sp;
+    *(--sp) = data;			/* argument of fn */
+    *(--sp) = (uint32_t)fn;		/* popped by kthread_start */
+    *(--sp) = (uint32_t)kthread_start;	/* switch_to returns here */
+    *(--sp) = 0;			/* ebp */
+    *(--sp) = 0;			/* ebx */
+    *(--sp) = 0;			/* esi */
+    *(--sp) = 0;			/* edi */
+    p->thread.esp = (uint32_t)sp;
+}
+/*
+ *  switch_task
+ *   DESCRIPTION: switches to the given task. The terminal and paging state
+ *                are brought over lazily, then switch_to swaps kernel stacks.
+ *                Returns when the calling task is scheduled again.
+ *   INPUTS: next - pcb of the next task to switch to
+ *   OUTPUTS: none
+ *   RETURN VALUE: -1 on fail and 0 on success
+ *   SIDE EFFECTS: must be called with interrupts off
+ */
+int32_t switch_task(proc_t* next)
+{
+    proc_t* prev = current_proc;
+    /* verify input and value of current pcb */
+    if (next == NULL || prev == NULL)
+	return -1;
+    if (next == prev)
+	return 0;
+    switch_tty(next);
+    switch_mm(next);
+    current_proc = next;                 /* update current proc pointer */
+    curr_pid     = next->pid;
+    vdso_set_task(next);
+    runqueue.current_pcb = next;
+    tss.ss0      = KERNEL_DS;
+    account_switch(prev, next);
+    fpu_switch(next);
+    switch_to(prev, next);
     return 0;
 }
 #endif
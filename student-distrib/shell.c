@@ -9,9 +9,8 @@
 #include "include/pit.h"
 #include "include/sched.h"
 #include "include/task.h"
+#include "include/pipe.h"
 #define KERNEL_PL 0
-runqueue_t runqueue;
-proc_t* current_proc;
 /*
  *  init_shell
  *   DESCRIPTION: initializes one shell
@@ -34,14 +33,9 @@ void* init_shell()
     shell_pcb->priority        = INTERACTIVE_PRIO;
     parent_pcb->child          = shell_pcb;
     current_proc               = shell_pcb;
-    shell->node                = (list_head_t*)ll_alloc(); /* allocate a listnode for the shell */
-    shell->node->pid = curr_pid;
-    shell->node->entry = (void*)shell;
-    current_queue = &runqueue.active_array->tasks[0]; /* point current queue to first queue entry in active array */
-    current_queue->head = shell->node; /* point head and last to same node */
-    current_queue->last = shell->node;
-    current_queue->ops  = &queue_ops_table; /* point to operations struct */
-    return (void*)shell->node;
+    shell->pid                 = curr_pid;
+    INIT_LIST_HEAD(&shell_pcb->tty_list); /* not on a terminal's chain yet */
+    return (void*)shell;
 }
 /*
  *  attach_shell
@@ -53,40 +47,24 @@ void* init_shell()
  */
 void* attach_shell(uint32_t term_id)
 {
-    cli();
-    terminal_session_t* current_term = getCurrentSession(); /* pointer to current tty */
-    /* Save context of current session */
-    if(term_id == 0)
-      save_vga_state_NO_MEMORY(&sessions[term_id].vga);
-    else
-      save_vga_state_NO_MEMORY(&sessions[term_id-1].vga);
-    if(term_id != current_term->id)
-    {
-      vga_mem_base = (uint32_t)sessions[term_id].vga.screen_start;
-    }
-    else
-      vga_mem_base = VIDEO_START_ADDR;
-    restore_vga_state_NO_MEMORY(&(sessions[term_id].vga));
-
+    cli(); /* VGA state is handed over to the shell's terminal by switch_task */
     pid_t* shell               = get_next_free_htable_entry(); /* point to next available process resources */
     curr_pid                   = next_free_pid(); 
     set_entry_by_index(pid_htable, curr_pid); /* mark PID as in use in bitmap */
     next_pid                   = next_free_pid(); /* update next_pid */
     proc_t* shell_pcb          = &shell->pcb;
     shell_pcb->parent          = NULL; /* base shell has no parent */
+    shell_pcb->background      = 0;
+    shell_pcb->policy          = SCHED_NORMAL;
+    shell_pcb->wake_boost      = 0;
+    shell_pcb->rt_priority     = 0;
     shell_pcb->priority        = INTERACTIVE_PRIO;
-    shell->node                = (list_head_t*)ll_alloc(); /* allocate memory for a list node */
     shell_pcb->terminal_id     = term_id; /* shell instance associated to a specific console */
     shell->pid                 = curr_pid;
     shell_pcb->pid             = curr_pid; /* assign a PID */
-    shell->node->entry         = (void*)shell;
-    sessions[term_id].queue    = &runqueue.active_array->tasks[term_id]; /* point queue to correct queue in runqueue structure */
-    current_queue              = sessions[term_id].queue;
-    current_queue->ops         = &queue_ops_table; /* associate queue to operations structure */
-    current_queue->head        = shell->node; /* point head and last nodes of list to head node */
-    current_queue->last        = shell->node;
-    current_queue->ops->insert_back(shell->node); /* enqueue node to back of list */
-    sessions[term_id].queue    = current_queue;
+    INIT_LIST_HEAD(&term_queues[term_id]);
+    list_add_tail(&shell_pcb->tty_list, &term_queues[term_id]); /* base shell heads the terminal's chain */
+    sessions[term_id].queue    = &term_queues[term_id];
     int32_t num                = next_free_file_table(); /* assign/initialize a file table for the shell */
     if (num == -1)
 	return 0;
@@ -117,20 +95,116 @@ void* attach_shell(uint32_t term_id)
     elf_section_header_table_t* elf_header = (elf_section_header_table_t*)(USER_CODE_LOAD_ADDR);
     shell_pcb->entry_point = elf_header->entry; /* point to executable's entry point */
     shell_pcb->state       = TASK_RUNNING;
-    SAVE_ESP(shell_pcb->kernel_regs); /* save ESP */
-    SAVE_EBP(shell_pcb->kernel_regs); /* save EBP */
-    tss.ss0 = KERNEL_DS;
-    tss.esp0 = KERNEL_STACK_ADDR(shell_pcb->pid); // Kernel stack for this pid declared by this macro
-    SAVE_REGS(current_proc->kernel_regs);
+    init_task_stats(shell_pcb);
+    init_task_context(shell_pcb, shell_pcb->entry_point); /* first switch_to IRETs into the shell */
     curr_pid = current_proc->pid;
-    current_proc = shell_pcb;
-    //send_eoi(0);
     PIT_tick += 1;
-    curr_file_table = &file_table[current_proc->file_table_num];
 
-    runqueue.n_runnable += 1; /* increment number of running processes */
-    sti();
-    JMP_TO_USER(shell_pcb->entry_point); /* set up stack for IRET and perform context switch */
-    return (void*)shell->node;
+    nr_tasks += 1; /* increment number of live processes */
+    activate_task(shell_pcb); /* shell is now picked by the scheduler */
+    switch_task(shell_pcb); /* run the shell, returns when this task is scheduled again */
+    return (void*)shell;
+}
+/*
+ *  is_pipeline
+ *   DESCRIPTION: checks a command for a '|'
+ *   INPUTS: cmd - command line
+ *   OUTPUTS: none
+ *   RETURN VALUE: 1 if it joins several commands, else 0
+ *   SIDE EFFECTS: none
+ */
+int32_t is_pipeline(const uint8_t* cmd)
+{
+    for (; *cmd != '\0'; cmd++) {
+	if (*cmd == '|')
+	    return 1;
+    }
+    return 0;
+}
+/*
+ *  abort_pipeline
+ *   DESCRIPTION: takes down the stages started before a later one failed.
+ *                They were queued with preemption off, so none has run.
+ *   INPUTS: stages - pcbs of the stages already started
+ *           n      - number of stages
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: frees their pids, the pipes go with their last reference
+ */
+static void abort_pipeline(proc_t** stages, int32_t n)
+{
+    int32_t i;
+    for (i = 0; i < n; i++) {
+	deactivate_task(stages[i]);
+	close_proc(stages[i]);
+	nr_tasks -= 1;
+    }
+    set_curr_file_table(current_proc->file_table_num); /* close_proc moved it */
+}
+/*
+ *  run_pipeline
+ *   DESCRIPTION: runs "a | b | c". Every stage is started in the background
+ *                by do_execute, writing into a pipe the next one reads.
+ *                Only the last stage is a child of the caller, the others
+ *                reap themselves. Nothing runs until every stage is queued,
+ *                so a stage that cannot start takes the others down with it.
+ *   INPUTS: command    - whole command line in a kernel buffer, cut up in place
+ *           terminal   - terminal of every stage
+ *           background - nonzero to return at once instead of waiting for
+ *                        the last stage
+ *   OUTPUTS: none
+ *   RETURN VALUE: halt status of the last stage, or its pid in the
+ *                 background, -1 if a stage could not be started
+ *   SIDE EFFECTS: blocks until the last stage halts in the foreground
+ */
+int32_t run_pipeline(uint8_t* command, int32_t terminal, int32_t background)
+{
+    proc_t* stages[MAX_PROCESSES];
+    int32_t n = 0;
+    uint8_t* stage = command;
+    uint8_t* bar;
+    pipe_t* in = NULL;
+    pipe_t* out;
+    int32_t last, len, pid, status;
+    preempt_disable();
+    while (1) {
+	for (bar = stage; *bar != '\0' && *bar != '|'; bar++);
+	last = (*bar == '\0');
+	*bar = '\0';
+	while (*stage == ' ')
+	    stage++;
+	len = (int32_t)strlen((const int8_t*)stage);
+	while (len > 0 && stage[len - 1] == ' ')
+	    stage[--len] = '\0';
+	out = last ? NULL : pipe_create();
+	if ((!last && out == NULL) || len == 0 || n == MAX_PROCESSES) {
+	    pipe_put(in, PIPE_READ_END);
+	    if (out != NULL) {
+		pipe_put(out, PIPE_READ_END);
+		pipe_put(out, PIPE_WRITE_END);
+	    }
+	    break;
+	}
+	/* the stage takes over in and the write end of out */
+	pid = do_execute(stage, terminal, 1, in, out);
+	if (pid == -1) {
+	    pipe_put(out, PIPE_READ_END);
+	    break;
+	}
+	stages[n++] = &pid_htable.pids[pid].pcb;
+	if (last) {
+	    preempt_enable();
+	    if (background)
+		return pid;
+	    if (wait_child(pid, &status, 0) != pid)
+		return -1;
+	    return status;
+	}
+	in = out; /* the read end stays here for the next stage */
+	stage = bar + 1;
+    }
+    abort_pipeline(stages, n);
+    preempt_enable();
+    return -1;
 }
 #endif
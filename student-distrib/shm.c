@@ -0,0 +1,382 @@
+#ifndef SHM_C
+#define SHM_C
+#include "include/shm.h"
+#include "include/task.h"
+#include "include/sched.h"
+#include "include/sys_call.h"
+#include "include/page.h"
+#include "include/lib.h"
+/* frames handed to segments, identity mapped in the kernel page */
+static uint8_t shm_frames[SHM_NR_FRAMES][__4KB__] __attribute__((aligned(__4KB__)));
+static uint8_t frame_refs[SHM_NR_FRAMES]; /* segment plus one per mapping */
+static shm_segment_t segments[SHM_MAX_SEGMENTS];
+/* window pages that have a mapping installed */
+static uint32_t shm_installed[SHM_WINDOW_PAGES / 32];
+/*
+ * shm_pte
+ *   DESCRIPTION: page table entry of a window page
+ *   INPUTS: page -- page index inside the window
+ *   OUTPUTS: none
+ *   RETURN VALUE: pointer to the entry in user_pte
+ *   SIDE EFFECTS: none
+ */
+static uint32_t* shm_pte(uint32_t page)
+{
+    uint32_t addr = USER_SHM_ADDR + page * __4KB__;
+    return &user_pte.pages[(addr >> PAGE_BITSHIFT) & PAGE_TABLE_MAX_SIZE];
+}
+/*
+ * frame_get / frame_put
+ *   DESCRIPTION: takes a zeroed frame from the pool, drops a reference to
+ *                one. A frame goes back to the pool with its last reference.
+ *   INPUTS: frame -- index of the frame to release
+ *   OUTPUTS: none
+ *   RETURN VALUE: frame_get returns the index, -1 if the pool is empty
+ *   SIDE EFFECTS: none
+ */
+static int32_t frame_get()
+{
+    int32_t i;
+    for (i = 0; i < SHM_NR_FRAMES; i++) {
+	if (frame_refs[i] == 0) {
+	    frame_refs[i] = 1;
+	    memset(shm_frames[i], 0, __4KB__);
+	    return i;
+	}
+    }
+    return -1;
+}
+static void frame_put(uint8_t frame)
+{
+    if (frame_refs[frame] > 0)
+	frame_refs[frame]--;
+}
+/*
+ * seg_free
+ *   DESCRIPTION: drops the frames of a segment and frees its slot
+ *   INPUTS: seg -- segment nobody maps anymore
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: the name can be created again
+ */
+static void seg_free(shm_segment_t* seg)
+{
+    uint32_t i;
+    for (i = 0; i < seg->npages; i++)
+	frame_put(seg->frames[i]);
+    seg->in_use  = 0;
+    seg->npages  = 0;
+    seg->nattach = 0;
+}
+/*
+ * shm_switch
+ *   DESCRIPTION: replaces the shared memory mappings installed in user_pte
+ *                by those of next. Returns right away when neither has any,
+ *                the common case.
+ *   INPUTS: next -- task about to run in user space
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: modifies user_pte and invalidates the pages it unmaps
+ */
+void shm_switch(proc_t* next)
+{
+    uint32_t* installed = shm_installed;
+    uint32_t page, i;
+    int32_t has_maps = 0;
+    for (i = 0; i < SHM_MAPS_PER_PROC; i++) {
+	if (next->shm_maps[i].seg != NULL)
+	    has_maps = 1;
+    }
+    if (!has_maps && installed[0] == 0 && installed[1] == 0)
+	return;
+    for (page = 0; page < SHM_WINDOW_PAGES; page++) {
+	if (installed[page / 32] & (1 << (page % 32))) {
+	    *shm_pte(page) = 0;
+	    flush_tlb_single(USER_SHM_ADDR + page * __4KB__);
+	}
+    }
+    installed[0] = 0;
+    installed[1] = 0;
+    /* entries that were not present are never cached, no flush needed */
+    for (i = 0; i < SHM_MAPS_PER_PROC; i++) {
+	shm_map_t* map = &next->shm_maps[i];
+	uint32_t first = (map->addr - USER_SHM_ADDR) / __4KB__;
+	if (map->seg == NULL)
+	    continue;
+	for (page = 0; page < map->seg->npages; page++) {
+	    *shm_pte(first + page) = (uint32_t)shm_frames[map->seg->frames[page]] | PRESENT | RW_EN | USER_EN;
+	    installed[(first + page) / 32] |= 1 << ((first + page) % 32);
+	}
+    }
+}
+/*
+ * shm_get
+ *   DESCRIPTION: looks a segment up by name, creating it if it is new
+ *   INPUTS: name -- name in kernel memory
+ *           size -- bytes wanted, rounded up to pages
+ *   OUTPUTS: none
+ *   RETURN VALUE: segment id, -1 on a bad size, if an existing segment is
+ *                 too small, or if no segment or frame is free
+ *   SIDE EFFECTS: a new segment is zero filled
+ */
+int32_t shm_get(const int8_t* name, uint32_t size)
+{
+    uint32_t npages = (size + __4KB__ - 1) / __4KB__;
+    int32_t id, free_id = -1;
+    uint32_t i;
+    if (size == 0 || npages > SHM_MAX_PAGES || name[0] == '\0')
+	return -1;
+    for (id = 0; id < SHM_MAX_SEGMENTS; id++) {
+	shm_segment_t* seg = &segments[id];
+	if (!seg->in_use) {
+	    if (free_id == -1)
+		free_id = id;
+	    continue;
+	}
+	if (strncmp(seg->name, name, SHM_NAME_LEN) == 0)
+	    return (npages <= seg->npages) ? id : -1;
+    }
+    if (free_id == -1)
+	return -1;
+    shm_segment_t* seg = &segments[free_id];
+    for (i = 0; i < npages; i++) {
+	int32_t frame = frame_get();
+	if (frame == -1) {
+	    seg->npages = i;
+	    seg_free(seg);
+	    return -1;
+	}
+	seg->frames[i] = frame;
+    }
+    strncpy(seg->name, name, SHM_NAME_LEN - 1);
+    seg->name[SHM_NAME_LEN - 1] = '\0';
+    seg->npages  = npages;
+    seg->nattach = 0;
+    seg->in_use  = 1;
+    return free_id;
+}
+/*
+ * shm_range_free
+ *   DESCRIPTION: checks that pages of the window are unused by a process
+ *   INPUTS: p      -- process
+ *           addr   -- user address of the first page, inside the window
+ *           npages -- length of the range
+ *   OUTPUTS: none
+ *   RETURN VALUE: 1 if the range is free and fits the window, else 0
+ *   SIDE EFFECTS: none
+ */
+static int32_t shm_range_free(proc_t* p, uint32_t addr, uint32_t npages)
+{
+    uint32_t end;
+    uint32_t i;
+    /* offsets into the window, addr + size could wrap past 4GB */
+    if (npages > SHM_WINDOW_PAGES || addr < USER_SHM_ADDR ||
+	    addr - USER_SHM_ADDR > (SHM_WINDOW_PAGES - npages) * __4KB__)
+	return 0;
+    end = addr + npages * __4KB__;
+    for (i = 0; i < SHM_MAPS_PER_PROC; i++) {
+	shm_map_t* map = &p->shm_maps[i];
+	if (map->seg == NULL)
+	    continue;
+	if (addr < map->addr + map->seg->npages * __4KB__ && map->addr < end)
+	    return 0;
+    }
+    return 1;
+}
+/*
+ * shm_attach
+ *   DESCRIPTION: maps a segment into a process
+ *   INPUTS: p    -- process, current_proc
+ *           id   -- segment id from shm_get
+ *           addr -- page aligned user address inside the window, 0 to
+ *                   take the lowest free range
+ *   OUTPUTS: none
+ *   RETURN VALUE: user address of the mapping, -1 on a bad id or address,
+ *                 or if the process maps SHM_MAPS_PER_PROC segments already
+ *   SIDE EFFECTS: the mapping is usable as soon as this returns
+ */
+int32_t shm_attach(proc_t* p, int32_t id, uint32_t addr)
+{
+    shm_segment_t* seg;
+    shm_map_t* map = NULL;
+    uint32_t i;
+    if (id < 0 || id >= SHM_MAX_SEGMENTS || !segments[id].in_use)
+	return -1;
+    seg = &segments[id];
+    for (i = 0; i < SHM_MAPS_PER_PROC; i++) {
+	if (p->shm_maps[i].seg == NULL) {
+	    map = &p->shm_maps[i];
+	    break;
+	}
+    }
+    if (map == NULL || (addr & (__4KB__ - 1)) != 0)
+	return -1;
+    if (addr == 0) {
+	for (addr = USER_SHM_ADDR; addr < USER_SHM_ADDR + SHM_WINDOW_PAGES * __4KB__; addr += __4KB__) {
+	    if (shm_range_free(p, addr, seg->npages))
+		break;
+	}
+    }
+    if (!shm_range_free(p, addr, seg->npages))
+	return -1;
+    map->seg  = seg;
+    map->addr = addr;
+    seg->nattach++;
+    for (i = 0; i < seg->npages; i++)
+	frame_refs[seg->frames[i]]++;
+    shm_switch(p);
+    return addr;
+}
+/*
+ * shm_unmap
+ *   DESCRIPTION: drops one mapping of a process, and the segment with its
+ *                last mapping
+ *   INPUTS: map -- slot of the mapping
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: page table entries are left to the caller
+ */
+static void shm_unmap(shm_map_t* map)
+{
+    shm_segment_t* seg = map->seg;
+    uint32_t i;
+    for (i = 0; i < seg->npages; i++)
+	frame_put(seg->frames[i]);
+    if (--seg->nattach <= 0)
+	seg_free(seg);
+    map->seg  = NULL;
+    map->addr = 0;
+}
+/*
+ * shm_detach
+ *   DESCRIPTION: unmaps the segment a process mapped at addr
+ *   INPUTS: p    -- process, current_proc
+ *           addr -- address shm_attach returned
+ *   OUTPUTS: none
+ *   RETURN VALUE: 0 on success, -1 if nothing is mapped there
+ *   SIDE EFFECTS: the pages fault from now on
+ */
+int32_t shm_detach(proc_t* p, uint32_t addr)
+{
+    uint32_t i;
+    for (i = 0; i < SHM_MAPS_PER_PROC; i++) {
+	if (p->shm_maps[i].seg != NULL && p->shm_maps[i].addr == addr) {
+	    shm_unmap(&p->shm_maps[i]);
+	    shm_switch(p);
+	    return 0;
+	}
+    }
+    return -1;
+}
+/*
+ * shm_exit
+ *   DESCRIPTION: drops every mapping of a finished process
+ *   INPUTS: p -- process
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: unmaps the pages right away if p is current_proc
+ */
+void shm_exit(proc_t* p)
+{
+    uint32_t i;
+    for (i = 0; i < SHM_MAPS_PER_PROC; i++) {
+	if (p->shm_maps[i].seg != NULL)
+	    shm_unmap(&p->shm_maps[i]);
+    }
+    if (p == current_proc)
+	shm_switch(p);
+}
+/*
+ * shm_frame_refs
+ *   DESCRIPTION: reference count of the frame behind a mapped address of
+ *                the current process
+ *   INPUTS: addr -- user address
+ *   OUTPUTS: none
+ *   RETURN VALUE: the count, -1 if addr is not mapped
+ *   SIDE EFFECTS: none
+ */
+int32_t shm_frame_refs(uint32_t addr)
+{
+    uint32_t i;
+    for (i = 0; i < SHM_MAPS_PER_PROC; i++) {
+	shm_map_t* map = &current_proc->shm_maps[i];
+	if (map->seg != NULL && addr >= map->addr && addr < map->addr + map->seg->npages * __4KB__)
+	    return frame_refs[map->seg->frames[(addr - map->addr) / __4KB__]];
+    }
+    return -1;
+}
+/*
+ * kernel_shmget
+ *   DESCRIPTION: finds or creates a named shared memory segment
+ *   INPUTS: name - (ebx) user string, at most SHM_NAME_LEN - 1 characters count
+ *           size - (ecx) bytes, at most SHM_MAX_PAGES pages
+ *   OUTPUTS: none
+ *   RETURN VALUE: segment id, -1 on failure
+ *   SIDE EFFECTS: none
+ */
+int32_t kernel_shmget()
+{
+    uint8_t* name;
+    uint32_t size;
+    int8_t kname[SHM_NAME_LEN];
+    uint32_t i;
+    asm ("			    \
+	    movl %%ebx, %0         ;\
+	    movl %%ecx, %1         ;\
+	    "
+	    :"=g"(name),"=g"(size)
+	    : /* no inputs */
+	    :"cc","memory"
+	);
+    if ((uint32_t)name < START_OF_USER || (uint32_t)name > (START_OF_USER + __4MB__ - SHM_NAME_LEN))
+	return -1;
+    for (i = 0; i < SHM_NAME_LEN - 1 && name[i] != '\0'; i++)
+	kname[i] = name[i];
+    kname[i] = '\0';
+    return shm_get(kname, size);
+}
+/*
+ * kernel_shmat
+ *   DESCRIPTION: maps a shared memory segment into the caller
+ *   INPUTS: id   - (ebx) segment id from shmget
+ *           addr - (ecx) page aligned address in the window, NULL to let
+ *                  the kernel choose
+ *   OUTPUTS: none
+ *   RETURN VALUE: address of the mapping, -1 on failure
+ *   SIDE EFFECTS: none
+ */
+int32_t kernel_shmat()
+{
+    int32_t id;
+    uint32_t addr;
+    asm ("			    \
+	    movl %%ebx, %0         ;\
+	    movl %%ecx, %1         ;\
+	    "
+	    :"=g"(id),"=g"(addr)
+	    : /* no inputs */
+	    :"cc","memory"
+	);
+    return shm_attach(current_proc, id, addr);
+}
+/*
+ * kernel_shmdt
+ *   DESCRIPTION: unmaps a shared memory segment from the caller
+ *   INPUTS: addr - (ebx) address shmat returned
+ *   OUTPUTS: none
+ *   RETURN VALUE: 0 on success, -1 on failure
+ *   SIDE EFFECTS: the segment is freed with its last mapping
+ */
+int32_t kernel_shmdt()
+{
+    uint32_t addr;
+    asm ("			    \
+	    movl %%ebx, %0         ;\
+	    "
+	    :"=g"(addr)
+	    : /* no inputs */
+	    :"cc","memory"
+	);
+    return shm_detach(current_proc, addr);
+}
+#endif
@@ -0,0 +1,295 @@
+#ifndef SPINLOCK_C
+#define SPINLOCK_C
+#include "include/spinlock.h"
+#include "include/sched.h"
+#include "include/clock.h"
+#include "include/lib.h"
+int32_t preempt_count = 0;
+#ifdef LOCK_DEBUG
+static spinlock_t* volatile lock_debug_list = NULL; /* every lock taken at least once */
+#endif
+/*
+ * xadd
+ *   DESCRIPTION: atomically adds val to *addr
+ *   INPUTS: addr - word to add to
+ *           val  - amount to add
+ *   OUTPUTS: none
+ *   RETURN VALUE: previous value of *addr
+ *   SIDE EFFECTS: full memory barrier
+ */
+static inline uint32_t xadd(volatile uint32_t* addr, uint32_t val)
+{
+    asm volatile("lock; xaddl %0, %1" : "+r"(val), "+m"(*addr) :: "memory", "cc");
+    return val;
+}
+/*
+ * cmpxchg
+ *   DESCRIPTION: atomically replaces *addr by new if it still holds old
+ *   INPUTS: addr - word to update
+ *           old  - expected value
+ *           new  - value to store
+ *   OUTPUTS: none
+ *   RETURN VALUE: value *addr had, equal to old on success
+ *   SIDE EFFECTS: full memory barrier
+ */
+static inline uint32_t cmpxchg(volatile uint32_t* addr, uint32_t old, uint32_t new)
+{
+    uint32_t prev;
+    asm volatile("lock; cmpxchgl %2, %1"
+		 : "=a"(prev), "+m"(*addr)
+		 : "r"(new), "0"(old)
+		 : "memory", "cc");
+    return prev;
+}
+#ifdef LOCK_DEBUG
+/*
+ * lock_debug_acquired / lock_debug_release
+ *   DESCRIPTION: bookkeeping of LOCK_DEBUG, run by the holder right after
+ *                taking the lock and right before dropping it
+ *   INPUTS: lock      - the lock
+ *           contended - nonzero if the caller had to wait for it
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: puts the lock on lock_debug_list the first time
+ */
+static void lock_debug_acquired(spinlock_t* lock, uint32_t contended)
+{
+    spinlock_t* head;
+    lock->owner = curr_pid;
+    lock->acquired_at = (tsc_khz != 0) ? rdtsc() : 0;
+    lock->n_acquired++;
+    if (contended)
+	lock->n_contended++;
+    if (lock->registered)
+	return;
+    lock->registered = 1;
+    do {
+	head = lock_debug_list;
+	lock->debug_next = head;
+    } while (cmpxchg((volatile uint32_t*)&lock_debug_list, (uint32_t)head, (uint32_t)lock) != (uint32_t)head);
+}
+static void lock_debug_release(spinlock_t* lock)
+{
+    uint64_t held = (tsc_khz != 0) ? rdtsc() - lock->acquired_at : 0;
+    lock->owner = -1;
+    lock->hold_total += held;
+    if (held > lock->hold_max)
+	lock->hold_max = held;
+}
+#endif
+/*
+ * spin_lock_init
+ *   DESCRIPTION: initializes an unlocked spinlock
+ *   INPUTS: lock - lock to initialize
+ *           name - shown by show_lock_stats, unused without LOCK_DEBUG
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+void spin_lock_init(spinlock_t* lock, const int8_t* name)
+{
+    if (lock == NULL)
+	return;
+    lock->slock = 0;
+#ifdef LOCK_DEBUG
+    lock->name        = name;
+    lock->owner       = -1;
+    lock->registered  = 0;
+    lock->n_acquired  = 0;
+    lock->n_contended = 0;
+    lock->hold_max    = 0;
+    lock->hold_total  = 0;
+    lock->debug_next  = NULL;
+#endif
+}
+/*
+ * _raw_spin_lock
+ *   DESCRIPTION: takes a ticket and spins until it is served. Tickets hand
+ *                the lock out in arrival order, so no CPU can starve. The
+ *                loop only reads so waiters do not bounce the cache line.
+ *   INPUTS: lock - lock to take
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: leaves the preempt count alone, for callers that
+ *                 already run with preemption or interrupts off
+ */
+void _raw_spin_lock(spinlock_t* lock)
+{
+    uint32_t ticket = TICKET_NEXT(xadd(&lock->slock, TICKET_NEXT_INC));
+#ifdef LOCK_DEBUG
+    uint32_t contended = (TICKET_OWNER(lock->slock) != ticket);
+#endif
+    while (TICKET_OWNER(lock->slock) != ticket)
+	asm volatile("pause" ::: "memory");
+#ifdef LOCK_DEBUG
+    lock_debug_acquired(lock, contended);
+#endif
+}
+/*
+ * _raw_spin_unlock
+ *   DESCRIPTION: serves the next ticket. Only the holder writes the lower
+ *                half, a 16 bit increment never carries into the tickets
+ *                being handed out.
+ *   INPUTS: lock - lock to release
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+void _raw_spin_unlock(spinlock_t* lock)
+{
+#ifdef LOCK_DEBUG
+    lock_debug_release(lock);
+#endif
+    asm volatile("incw %0" : "+m"(*(volatile uint16_t*)&lock->slock) :: "memory", "cc");
+}
+/*
+ * _raw_spin_trylock
+ *   DESCRIPTION: takes the lock only if nobody holds or waits for it
+ *   INPUTS: lock - lock to take
+ *   OUTPUTS: none
+ *   RETURN VALUE: 1 if the lock was taken, 0 otherwise
+ *   SIDE EFFECTS: none
+ */
+int32_t _raw_spin_trylock(spinlock_t* lock)
+{
+    uint32_t old = lock->slock;
+    if (TICKET_OWNER(old) != TICKET_NEXT(old))
+	return 0;
+    if (cmpxchg(&lock->slock, old, old + TICKET_NEXT_INC) != old)
+	return 0;
+#ifdef LOCK_DEBUG
+    lock_debug_acquired(lock, 0);
+#endif
+    return 1;
+}
+/*
+ * spin_is_locked
+ *   DESCRIPTION: checks whether the lock is held
+ *   INPUTS: lock - lock to check
+ *   OUTPUTS: none
+ *   RETURN VALUE: 1 if held, 0 if free
+ *   SIDE EFFECTS: none
+ */
+int32_t spin_is_locked(spinlock_t* lock)
+{
+    uint32_t v = lock->slock;
+    return TICKET_OWNER(v) != TICKET_NEXT(v);
+}
+/*
+ * preempt_disable / preempt_enable
+ *   DESCRIPTION: a task holding a spinlock must not be switched out, the
+ *                next task on this CPU could spin on the same lock forever.
+ *                Interrupt handlers check preemptible before calling
+ *                schedule and leave need_resched set otherwise, the
+ *                outermost preempt_enable then runs the switch.
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: preempt_enable may call schedule if interrupts are on
+ */
+void preempt_disable()
+{
+    preempt_count++;
+    asm volatile("" ::: "memory");
+}
+void preempt_enable()
+{
+    uint32_t flags;
+    preempt_enable_no_resched();
+    asm volatile("pushfl; popl %0" : "=r"(flags));
+    if (!(flags & EFLAGS_IF))
+	return; /* interrupts off, the caller or the next interrupt reschedules */
+    cli();
+    if (preemptible() && runqueue.need_resched)
+	schedule();
+    sti();
+}
+void preempt_enable_no_resched()
+{
+    asm volatile("" ::: "memory");
+    if (preempt_count > 0)
+	preempt_count--;
+}
+/*
+ * preemptible
+ *   DESCRIPTION: checks whether the code an interrupt handler is about to
+ *                return to may be switched out
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: 1 if no spinlock is held
+ *   SIDE EFFECTS: none
+ */
+int32_t preemptible()
+{
+    return preempt_count == 0;
+}
+/*
+ * spin_lock / spin_unlock / spin_trylock
+ *   DESCRIPTION: ticket lock that leaves the interrupt flag alone. Enough
+ *                for data no interrupt handler touches, and inside handlers
+ *                themselves. Process context sharing data with a handler
+ *                uses the irqsave variants.
+ *   INPUTS: lock - the lock
+ *   OUTPUTS: none
+ *   RETURN VALUE: spin_trylock returns 1 if it got the lock
+ *   SIDE EFFECTS: preemption is off while the lock is held
+ */
+void spin_lock(spinlock_t* lock)
+{
+    preempt_disable();
+    _raw_spin_lock(lock);
+}
+void spin_unlock(spinlock_t* lock)
+{
+    _raw_spin_unlock(lock);
+    preempt_enable();
+}
+int32_t spin_trylock(spinlock_t* lock)
+{
+    preempt_disable();
+    if (_raw_spin_trylock(lock))
+	return 1;
+    preempt_enable_no_resched();
+    return 0;
+}
+/*
+ * spin_unlock_irqrestore
+ *   DESCRIPTION: releases a lock taken with spin_lock_irqsave and puts the
+ *                interrupt flag back
+ *   INPUTS: lock  - the lock
+ *           flags - EFLAGS saved by spin_lock_irqsave
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: may reschedule once interrupts are back on
+ */
+void spin_unlock_irqrestore(spinlock_t* lock, uint32_t flags)
+{
+    _raw_spin_unlock(lock);
+    restore_flags(flags);
+    preempt_enable();
+}
+/*
+ * show_lock_stats
+ *   DESCRIPTION: prints the LOCK_DEBUG numbers of every lock taken so far,
+ *                at the current VGA position
+ *   INPUTS: none
+ *   OUTPUTS: one line per lock
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: writes to the screen selected by vga_mem_base
+ */
+void show_lock_stats()
+{
+#ifdef LOCK_DEBUG
+    spinlock_t* lock;
+    uint64_t avg;
+    vga_printf("LOCK          TAKEN  CONTENDED  MAX(ns)  AVG(ns)\n");
+    for (lock = lock_debug_list; lock != NULL; lock = lock->debug_next) {
+	avg = lock->hold_total;
+	if (lock->n_acquired != 0)
+	    div64_32(&avg, lock->n_acquired);
+	vga_printf("%s  %u  %u  %u  %u\n", (lock->name != NULL) ? lock->name : "?", lock->n_acquired, lock->n_contended,
+		   (uint32_t)cycles_to_ns(lock->hold_max), (uint32_t)cycles_to_ns(avg));
+    }
+#endif
+}
+#endif
@@ -17,10 +17,16 @@
 #include "include/sched.h"
 #include "include/terminal.h"
 #include "include/vga.h"
+#include "include/clock.h"
+#include "include/timer.h"
 #include "include/task.h"
+#include "include/vdso.h"
+#include "include/syscall_stat.h"
+#include "include/pipe.h"
+#include "include/exec_cache.h"
+#include "include/shell.h"
 #define USER_PL 3
 #define KERNEL_PL 0
-//queue_t* current_queue;
 /*
  * init_sys_call
  *   DESCRIPTION: initializes all the system calls
@@ -40,7 +46,139 @@ void init_sys_call()
   fill_interrupt(SYS_CALL_VEC,(uint32_t*)sys_call_vector,segSize,flags);
 }
 
+uint8_t sysenter_enabled = 0;
+uint8_t vsyscall_page[__4KB__] __attribute__((aligned(__4KB__)));
+/*
+ * has_sep
+ *   DESCRIPTION: checks cpuid for sysenter/sysexit. The first Pentium Pro
+ *                steppings report SEP without supporting it.
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: 1 if sysenter is available, 0 otherwise
+ *   SIDE EFFECTS: none
+ */
+static int32_t has_sep()
+{
+  uint32_t eax = 1, ebx, ecx, edx;
+  asm volatile("cpuid" : "+a"(eax), "=b"(ebx), "=c"(ecx), "=d"(edx));
+  if (!(edx & CPUID_FEAT_SEP))
+    return 0;
+  if (((eax >> 8) & 0xF) == 6 && ((eax >> 4) & 0xF) < 3 && (eax & 0xF) < 3)
+    return 0;
+  return 1;
+}
+/*
+ * sysenter_init
+ *   DESCRIPTION: fills the stub page user space calls instead of int $0x80:
+ *                the sysenter entry when the CPU has it, int $0x80 otherwise.
+ *                The page is mapped next
+ *                to the vidmap page and the SYSENTER MSRs point at
+ *                sysenter_entry. The entry stack is the TSS itself,
+ *                sysenter_entry loads esp0 from it so task switches need
+ *                not touch the MSRs.
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: maps the stub page and writes the SYSENTER MSRs
+ */
+void sysenter_init()
+{
+  memset(vsyscall_page, 0, __4KB__);
+  if (has_sep()) {
+    memcpy(vsyscall_page, vsyscall_sysenter, vsyscall_sysenter_end - vsyscall_sysenter);
+    sysenter_enabled = 1;
+  } else {
+    memcpy(vsyscall_page, vsyscall_int80, vsyscall_int80_end - vsyscall_int80);
+  }
+  page_directory.directory_table[USER_VIDEO_MEM_ADDR >> PMD_SHIFT] =
+    (uint32_t)user_pte.pages | PRESENT | RW_EN | USER_EN;
+  user_pte.pages[(USER_VSYSCALL_ADDR >> PAGE_BITSHIFT) & PAGE_TABLE_MAX_SIZE] =
+    (uint32_t)vsyscall_page | PRESENT | USER_EN; /* read-only */
+  flush_tlb_single(USER_VSYSCALL_ADDR);
+  if (!sysenter_enabled)
+    return;
+  wrmsr(MSR_SYSENTER_CS, KERNEL_CS, 0);
+  wrmsr(MSR_SYSENTER_ESP, (uint32_t)&tss, 0);
+  wrmsr(MSR_SYSENTER_EIP, (uint32_t)sysenter_entry, 0);
+}
+
 static int32_t result;
+static DECLARE_WAIT_QUEUE(child_exit_wq); /* parents blocked in waitpid */
+/*
+ * reap_zombie
+ *   DESCRIPTION: frees the pid of a background child that halted, once its
+ *                status has been collected or nobody is left to collect it
+ *   INPUTS: p - zombie to free
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: the pid and its user page may be reused right away
+ */
+static void reap_zombie(proc_t* p)
+{
+  nr_tasks -= 1; /* zombies count as live, they keep their pid and user page */
+  release_proc(p);
+}
+/*
+ * orphan_children
+ *   DESCRIPTION: detaches the background children of a halting process.
+ *                Zombies among them are reaped, running ones free themselves
+ *                when they halt since nobody can wait for them anymore.
+ *   INPUTS: parent - process that is halting
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+static void orphan_children(proc_t* parent)
+{
+  int16_t pid;
+  proc_t* p;
+  for (pid = 1; pid < MAX_PIDS_IN_BITMAP; pid++) {
+      if ((pid_htable.bitmap & (1 << pid)) == 0)
+	  continue;
+      p = &pid_htable.pids[pid].pcb;
+      if (p->parent != parent || !p->background)
+	  continue;
+      if (p->state == TASK_ZOMBIE)
+	  reap_zombie(p);
+      else
+	  p->parent = NULL;
+  }
+}
+/*
+ * exit_background
+ *   DESCRIPTION: halt of a background child. There is no suspended parent
+ *                to unwind into, so the child releases its files, stays a
+ *                zombie holding its exit status and switches away for good.
+ *                The pid is freed by waitpid, or right here for an orphan.
+ *                Like kthread_exit that is safe while still on its kernel
+ *                stack: interrupts stay off until the switch is done.
+ *   INPUTS: p      - halting process, current_proc
+ *           status - halt status
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: never returns, wakes the parent in waitpid
+ */
+static void exit_background(proc_t* p, uint8_t status)
+{
+  deactivate_task(p);
+  exit_proc(p);
+  orphan_children(p);
+  p->exit_status = status;
+  if (exception_flag == 1) {
+      p->exit_status = DIE_BY_EXECPT;
+      exception_flag = 0;
+  }
+  cli();
+  if (p->parent == NULL) {
+      reap_zombie(p);
+  } else {
+      p->state = TASK_ZOMBIE;
+      wake_up(&child_exit_wq);
+  }
+  preempt_enable_no_resched();
+  schedule();
+  while (1);
+}
 /*
  * kernel_halt
  *   DESCRIPTION: terminates a process
@@ -59,30 +197,38 @@ int32_t kernel_halt()
 	  : /* no inputs */
 	  :"cc", "memory"
      );
-  cli(); /* critical section start */
+  preempt_disable(); /* no task switch while current_proc and the pid table change */
 
   /* verify that the correct pcb is being referenced */
   pid_t* current_htable_entry = get_current_htable_entry();
   proc_t*	 proc_to_halt = (proc_t*)&current_htable_entry->pcb;
   proc_t*	 proc_to_resume;
-  current_queue = sessions[current_proc->terminal_id].queue; /* point to correct queue */
+  if (proc_to_halt->background)
+      exit_background(proc_to_halt, status); /* nothing to unwind into */
+  orphan_children(proc_to_halt);
   proc_to_resume   = proc_to_halt->parent; /* point to correct parent pcb */
   /* Clear the keyboard terminal of this process */
   sessions[current_proc->terminal_id].index = 0;
 
   /* case to handle exiting the \"base shell\" for that terminal */
   if (proc_to_resume == NULL || (proc_to_resume->pid == KERNEL_PID)) {
-      pid_t* hpid          = (pid_t*)sessions[proc_to_halt->terminal_id].queue->head->entry;
-      current_proc         = &hpid->pcb;
+      current_proc         = list_first_entry(sessions[proc_to_halt->terminal_id].queue, proc_t, tty_list);
       set_curr_file_table(current_proc->file_table_num);
       runqueue.current_pcb = current_proc;
       curr_pid             = current_proc->pid; 
+      vdso_set_task(current_proc);
+      fpu_release(current_proc); /* restarted shell starts with a clean FPU */
+      preempt_enable_no_resched();
       JMP_TO_USER(current_proc->entry_point); /* resume current process */
   }
+  /* take the halting process off the runqueue and wake the parent blocked in execute */
+  deactivate_task(proc_to_halt);
+  activate_task(proc_to_resume);
+  account_switch(proc_to_halt, proc_to_resume);
   /* disassociate pcb from its resources */
   close_proc(proc_to_halt);
   __map_user_page(VIDEO_START_ADDR, USER_VIDEO_MEM_ADDR, 0); // Un-map the video memory
-  current_queue->ops->remove(current_queue->last); /* remove node from end of queue */
+  list_del_init(&proc_to_halt->tty_list); /* unlink from the terminal's chain in O(1) */
   if(curr_pid >= 1) {
       next_pid = next_free_pid();
   }
@@ -90,11 +236,14 @@ int32_t kernel_halt()
 				     to the correct pcb */
   current_proc   = proc_to_resume;
   current_proc->child = NULL;
+  vdso_set_task(current_proc);
+  shm_switch(current_proc);
   set_curr_file_table(current_proc->file_table_num); /* re-establish file table instance */
   if (curr_file_table == NULL) {
       init_file_table(curr_file_table);
   }
   runqueue.current_pcb = current_proc; 
+  fpu_switch(current_proc);
   tss.esp0 =  KERNEL_STACK_ADDR(curr_pid);
   asm volatile("movl %0, %%edx"::"r"((int32_t)status)); // Need to deal with switching stacks so save the var in a reg
   RESTORE_ESP(proc_to_resume->kernel_regs);
@@ -118,29 +267,65 @@ int32_t kernel_halt()
     else
       shell_showing = 0;
   }
-  /* update runqueue count of runnable processes */
-  runqueue.n_runnable -= 1;
-  sti();
+  /* update runqueue count of live processes */
+  nr_tasks -= 1;
+  preempt_enable();
   return (int32_t)result;
 }
 
+/*
+ * strip_background
+ *   DESCRIPTION: checks a command for a trailing '&' and cuts it off along
+ *                with the blanks around it
+ *   INPUTS: cmd - command in a kernel buffer
+ *   OUTPUTS: cmd without the '&'
+ *   RETURN VALUE: 1 if the command asked to run in the background, else 0
+ *   SIDE EFFECTS: none
+ */
+static int32_t strip_background(uint8_t* cmd)
+{
+    int32_t i = (int32_t)strlen((const int8_t*)cmd) - 1;
+    while (i >= 0 && (cmd[i] == ' ' || cmd[i] == '\n' || cmd[i] == '\r'))
+	i--;
+    if (i < 0 || cmd[i] != '&')
+	return 0;
+    cmd[i--] = '\0';
+    while (i >= 0 && cmd[i] == ' ')
+	cmd[i--] = '\0';
+    return 1;
+}
+
+/*
+ * drop_exec_pipes
+ *   DESCRIPTION: drops the pipes of a process do_execute failed to create
+ *   INPUTS: in  - read end meant for descriptor 0, may be NULL
+ *           out - write end meant for descriptor 1, may be NULL
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: the other ends see EOF or a broken pipe
+ */
+static void drop_exec_pipes(pipe_t* in, pipe_t* out)
+{
+    pipe_put(in, PIPE_READ_END);
+    pipe_put(out, PIPE_WRITE_END);
+}
+
 /*
  * kernel_execute
- *   DESCRIPTION: attempts to load and execute a new program
+ *   DESCRIPTION: attempts to load and execute a new program on the caller's
+ *                terminal. A command ending in '&' starts the program in
+ *                the background, see do_execute.
  *   INPUTS: command - name of proces to execute
  *   OUTPUTS: none
- *   RETURN VALUE: none
+ *   RETURN VALUE: halt status of the child, or the child's pid in the
+ *                 background, -1 on failure
  *   SIDE EFFECTS: changes the page directory entry to the new process
  */
-
-uint8_t kern_cmd_buf[TERMINAL_BUF_SIZE];
-uint8_t cmd_buf[TERMINAL_BUF_SIZE];
-uint8_t arg_buf[TERMINAL_BUF_SIZE];
-uint8_t file_buf[TERMINAL_BUF_SIZE];
-proc_t* pcb;
+static uint8_t exec_buf[TERMINAL_BUF_SIZE];
 int32_t kernel_execute()
 {
     uint8_t* command;
+    int32_t background;
     asm ("                      \
 	    movl %%ebx, %0     ;\
 	    "
@@ -149,24 +334,63 @@ int32_t kernel_execute()
 	    :"cc","memory"
 	);
     if(command == NULL)
-	     return P_FAIL;
+	return P_FAIL;
+    strncpy((int8_t*)exec_buf, (const int8_t*)command, TERMINAL_BUF_SIZE - 1);
+    exec_buf[TERMINAL_BUF_SIZE - 1] = '\0';
+    background = strip_background(exec_buf);
+    if (is_pipeline(exec_buf))
+	return run_pipeline(exec_buf, current_proc->terminal_id, background);
+    return do_execute(exec_buf, current_proc->terminal_id, background, NULL, NULL);
+}
+
+/*
+ * do_execute
+ *   DESCRIPTION: loads and starts a program. In the foreground the caller
+ *                sleeps until the child halts and kernel_halt returns
+ *                through this frame. In the background the child gets its
+ *                own kernel context and the caller keeps running,
+ *                collecting it later with waitpid. A background child
+ *                given a pipe to write to is a pipeline stage and reaps
+ *                itself.
+ *   INPUTS: command    - command line in a kernel buffer, without the '&'
+ *           terminal   - terminal the child reads and writes
+ *           background - nonzero to return at once with the child's pid
+ *           in         - pipe read end for descriptor 0, NULL for the terminal
+ *           out        - pipe write end for descriptor 1, NULL for the terminal
+ *   OUTPUTS: none
+ *   RETURN VALUE: halt status of the child, or the child's pid in the
+ *                 background, -1 on failure
+ *   SIDE EFFECTS: changes the page directory entry to the new process. The
+ *                 child takes over the references to in and out, they are
+ *                 dropped if it cannot be started
+ */
+uint8_t kern_cmd_buf[TERMINAL_BUF_SIZE];
+uint8_t cmd_buf[TERMINAL_BUF_SIZE];
+uint8_t arg_buf[TERMINAL_BUF_SIZE];
+uint8_t file_buf[TERMINAL_BUF_SIZE];
+proc_t* pcb;
+int32_t do_execute(uint8_t* command, int32_t terminal, int32_t background, pipe_t* in, pipe_t* out)
+{
     /* check that we do not try to execute more than a fixed number of processes */
-    if(runqueue.n_runnable >= MAX_PROCESSES)
+    if(nr_tasks >= MAX_PROCESSES) {
+      drop_exec_pipes(in, out);
       return -1;
+    }
     //vga_printf("Num Processes: %x\n", runqueue.n_runnable);
-    cli();
+    preempt_disable(); /* interrupts stay on, but nothing may switch away mid-setup */
     /* update value for next_pid and establish pointer to next table entry where
      * pcb resources are statically allocated */
     next_pid                    = next_free_pid();
     pid_t* htable_entry         = get_next_free_htable_entry();
     pcb                         = &htable_entry->pcb;
-    pid_t* parent               = (pid_t*)getCurrentSession()->queue->last->entry;
-    proc_t* parent_proc         = &parent->pcb; /* pointer to parent process */
-    uint32_t index              = 0;
+    proc_t* parent_proc         = current_proc; /* pointer to parent process */
     proc_t temp;
     int32_t cmd_len             = parse_file(file_buf, command);
-    if (cmd_len == -1)
+    if (cmd_len == -1) {
+	drop_exec_pipes(in, out);
+	preempt_enable();
 	return P_FAIL;
+    }
 
     strcpy((int8_t*)cmd_buf, (int8_t*)command); /* copy into kernel space      */
     parse_command_args(&temp, cmd_buf);         /* populate fields in temp pcb */
@@ -177,15 +401,19 @@ int32_t kernel_execute()
 					 defaults or values depending PID */
     curr_pid = pcb->pid;              /* update curr_pid and next_pid     */
     next_pid = next_free_pid();
-    pcb->terminal_id = parent_proc->terminal_id; /* associate pcb to a tty session */
-    parent_proc->child = pcb; /* establish parent/child relationship among processes */
+    pcb->terminal_id = terminal; /* associate pcb to a tty session */
+    if (!background)
+	parent_proc->child = pcb; /* establish parent/child relationship among processes */
     pcb->parent = parent_proc;
     pcb->state  = TASK_RUNNING; /* set the state */
-    // Check if file exists
-    int8_t valid = check_elf((uint8_t*)file_buf);
-    if(valid == P_FAIL || cmd_buf == NULL || strlen((const int8_t*)cmd_buf) == 0) 
+    // Check if file exists, one lookup that a recently run program hits in the cache
+    exec_image_t* image = exec_cache_get(file_buf);
+    if(image == NULL || cmd_buf == NULL || strlen((const int8_t*)cmd_buf) == 0) {
 	// File was not found or not valid P_FAIL == -1
+	drop_exec_pipes(in, out);
+	preempt_enable();
 	return P_FAIL;
+    }
     uint32_t phys_addr    = PHYS_ADDR_START(pcb->pid); 
     uint32_t virt_addr    = START_OF_USER;
     /* Need to change the physical address since its a new program */
@@ -193,8 +421,11 @@ int32_t kernel_execute()
     /* Need to associate/initialize a file table to the process that is separate from the parent */
     if (pcb->open_files == NULL || pcb->open_files == parent_proc->open_files) {
 	int32_t num = next_free_file_table();
-	if (num == -1)
+	if (num == -1) {
+	    drop_exec_pipes(in, out);
+	    preempt_enable();
 	    return -1;
+	}
 	pcb->file_table_num = num;
 	set_curr_file_table(pcb->file_table_num);
 	pcb->open_files     = curr_file_table;
@@ -202,35 +433,48 @@ int32_t kernel_execute()
 	file_table_bitmap |= (1 << pcb->file_table_num);
     }
     fs_t* proc_files = pcb->open_files->files;
-    current_queue = getCurrentSession()->queue; /* update current queue pointer */
-    current_queue->ops->insert_back(htable_entry->node); /* enqueue entry */
+    /* a pipeline stage reads or writes a pipe instead of the terminal */
+    if (in != NULL)
+	pipe_attach(&proc_files[0], in, PIPE_READ_END);
+    if (out != NULL)
+	pipe_attach(&proc_files[1], out, PIPE_WRITE_END);
+    if (!background)
+	list_add_tail(&pcb->tty_list, sessions[pcb->terminal_id].queue); /* child is the terminal's new foreground */
     memcpy((void*)kern_cmd_buf, (void*)cmd_buf, cmd_len);
     //parse_command_args(pcb, kern_cmd_buf);
-    index = 1 + bitscan_reverse(pcb->open_files->bitmap); /* calculate free index in array of file structs */
-    uint8_t current_f_idx = index;
-    fs_t* file = &(proc_files[current_f_idx]);		/* pointer to current file */
-
-    fs_open(current_f_idx, file_buf, 0);	/* open the file so it may be used by the proc */
-    /* bookkeeping variables to handle the memcpy */
     __map_page_directory(phys_addr, virt_addr, PRESENT | RW_EN | USER_EN | EXTENDED_PAGING);
     flush_tlb();
-    uint32_t length = file->inode->length;
 
     // Copy over the code to the right place in virual memory
-    fs_read(current_f_idx, (uint8_t*)(USER_CODE_LOAD_ADDR), length);
-    fs_close(current_f_idx, pcb->command, 0);
-    elf_section_header_table_t* elf_header = (elf_section_header_table_t*)(USER_CODE_LOAD_ADDR);
-    pcb->entry_point = elf_header->entry; /* point to executable's entry point */
-
+    exec_cache_load(image);
+    pcb->entry_point = image->header.entry; /* point to executable's entry point */
 
+    if (background) {
+	/* first switch_to IRETs into the child, the caller returns with its pid */
+	pcb->background = 1;
+	if (out != NULL)
+	    pcb->parent = NULL; /* nobody waits for a stage, it reaps itself */
+	init_task_context(pcb, pcb->entry_point);
+	__map_page_directory(PHYS_ADDR_START(parent_proc->pid), virt_addr, PRESENT | RW_EN | USER_EN | EXTENDED_PAGING);
+	flush_tlb();
+	curr_pid = parent_proc->pid;
+	set_curr_file_table(parent_proc->file_table_num);
+	nr_tasks += 1;
+	activate_task(pcb); /* first runs at the next switch */
+	preempt_enable();
+	return pcb->pid;
+    }
     tss.ss0 = KERNEL_DS;
     tss.esp0 = KERNEL_STACK_ADDR(pcb->pid); /* Kernel stack for this pid declared by this macro */
+    pcb->thread.esp0 = tss.esp0; /* reloaded by switch_to when the child is rescheduled */
     SAVE_REGS(pcb->kernel_regs); /* save hardware context */
     SAVE_REGS(parent_proc->kernel_regs); /* ^ */
     SAVE_ESP(parent_proc->kernel_regs); /* save ESP */
     SAVE_EBP(parent_proc->kernel_regs); /* save EBP */
     //SAVE_REGS(pcb->kernel_regs);
     current_proc = pcb; /* update current_proc pointer */
+    vdso_set_task(pcb);
+    shm_switch(pcb);  /* the parent's segments are not the child's */
 
     // Special ctrl is needed for the shell process
     if(pcb->terminal_id == current_session)
@@ -242,9 +486,13 @@ int32_t kernel_execute()
     }
 
     runqueue.current_pcb = current_proc;
-    runqueue.n_runnable += 1; /* increment number of runnable processes */
+    nr_tasks += 1; /* increment number of live processes */
+    deactivate_task(parent_proc); /* parent sleeps in execute until the child halts */
+    account_switch(parent_proc, pcb);
+    activate_task(pcb);
+    fpu_switch(pcb); /* parent's FPU registers stay live until the child touches them */
+    preempt_enable_no_resched(); /* the child starts with a fresh slice anyway */
     JMP_TO_USER(pcb->entry_point); /* set up stack for IRET and perform context switch */
-    sti();
     return 0;
 }
 
@@ -327,7 +575,6 @@ int32_t kernel_write()
     uint32_t pos;
     if(nbytes < 0 || fd < 0 || buf == NULL || fd >= MAX_NUM_FD) // Cant write negative bytes, negative fd, or write to NULL
 	return -1;
-    cli();
     //curr_file_table = &file_table[current_proc->file_table_num];
     //file_table_t* files = curr_file_table;
     file_table_t* files   = current_proc->open_files;
@@ -335,8 +582,7 @@ int32_t kernel_write()
 	return -1;
     fs_t* files_ptr     = files->files; /* pointers used to make code more readable */
     fs_t* file = &files_ptr[fd];
-    pos = file->op_ptr->write(fd, (uint8_t*)buf, nbytes);
-    sti();
+    pos = file->op_ptr->write(fd, (uint8_t*)buf, nbytes); /* each device locks for itself */
     return pos;
 }
 
@@ -495,7 +741,7 @@ int32_t kernel_vidmap()
     if((uint32_t)screen_start < USER_CODE_LOAD_ADDR || (uint32_t)screen_start > (START_OF_USER + __4MB__))
 	return -1;
 
-    cli();
+    spin_lock(&tty_lock); /* current_session must not change under us */
     if(current_proc->terminal_id == current_session)
       __map_user_page(VIDEO_START_ADDR, USER_VIDEO_MEM_ADDR, PRESENT | RW_EN | USER_EN);
     else
@@ -505,7 +751,7 @@ int32_t kernel_vidmap()
 
     *screen_start = (uint8_t*)USER_VIDEO_MEM_ADDR;
     current_proc->is_vidmapped = 1; /* set is_vidmapped flag */
-    sti();
+    spin_unlock(&tty_lock);
     return USER_VIDEO_MEM_ADDR;
 }
 
@@ -535,32 +781,315 @@ int32_t kernel_sigreturn(void)
     return 0;
 }
 
-/* EXTRA CREDIT
- * check_elf
- *   DESCRIPTION: checks that the file to look at is an elf file
- *   INPUTS: file_name: the filename you want to check
- *   OUTPUTS:
- *   RETURN VALUE: returns -1 if not valid 0 if valid
- *   SIDE EFFECTS: checks the filename
+/*
+ * kernel_gettime
+ *   DESCRIPTION: copies the monotonic clock into a user timespec
+ *   INPUTS: ts - (ebx) user pointer to a timespec_t
+ *   OUTPUTS: none
+ *   RETURN VALUE: 0 on success, -1 if ts is outside the user page
+ *   SIDE EFFECTS: none
  */
-int32_t check_elf(uint8_t* file_name)
+int32_t kernel_gettime()
 {
-    uint32_t valid;
-    dentry_t process_entry;
-    boot_block_t* boot_block =  (boot_block_t*)fs_img_addr;
+    timespec_t* ts;
+    asm ("		       \
+	    movl %%ebx, %0;   \
+	    "
+	    :"=g"(ts)
+	    :/* no inputs */
+	    :"cc","memory"
+	);
+    if ((uint32_t)ts < START_OF_USER || (uint32_t)ts > (START_OF_USER + __4MB__ - sizeof(timespec_t)))
+	return -1;
+    ns_to_timespec(clock_ns(), ts);
+    return 0;
+}
 
-    valid = read_dentry_by_name((const uint8_t*)file_name, &process_entry);
-    if(valid == -1)
+/*
+ * kernel_sleep
+ *   DESCRIPTION: parks the caller on a timer until ms have passed
+ *   INPUTS: ms - (ebx) time to sleep in ms
+ *   OUTPUTS: none
+ *   RETURN VALUE: 0
+ *   SIDE EFFECTS: the caller is off the runqueue while it sleeps
+ */
+int32_t kernel_sleep()
+{
+    uint32_t ms;
+    asm ("		       \
+	    movl %%ebx, %0;   \
+	    "
+	    :"=g"(ms)
+	    :/* no inputs */
+	    :"cc","memory"
+	);
+    return sleep_ticks(ms_to_jiffies(ms));
+}
+/*
+ * kernel_getrusage
+ *   DESCRIPTION: copies the CPU accounting of a process to user space
+ *   INPUTS: pid - (ebx) process to report, 0 for the caller
+ *           ru  - (ecx) user pointer to a rusage_t
+ *   OUTPUTS: none
+ *   RETURN VALUE: 0 on success, -1 on a free pid or a pointer outside the user page
+ *   SIDE EFFECTS: none
+ */
+int32_t kernel_getrusage()
+{
+    int32_t pid;
+    rusage_t* ru;
+    asm ("			    \
+	    movl %%ebx, %0         ;\
+	    movl %%ecx, %1         ;\
+	    "
+	    :"=g"(pid),"=g"(ru)
+	    : /* no inputs */
+	    :"cc","memory"
+	);
+    if ((uint32_t)ru < START_OF_USER || (uint32_t)ru > (START_OF_USER + __4MB__ - sizeof(rusage_t)))
+	return -1;
+    if (pid == 0)
+	pid = current_proc->pid;
+    if (pid < 0 || pid >= MAX_PIDS_IN_BITMAP || (pid_htable.bitmap & (1 << pid)) == 0)
+	return -1;
+    return fill_rusage(&pid_htable.pids[pid].pcb, ru);
+}
+
+/*
+ * kernel_setscheduler
+ *   DESCRIPTION: changes the scheduling policy of a process
+ *   INPUTS: pid         - (ebx) process to change, 0 for the caller
+ *           policy      - (ecx) SCHED_NORMAL, SCHED_FIFO or SCHED_RR
+ *           rt_priority - (edx) 1..RT_MAX_PRIO for FIFO/RR, 0 for SCHED_NORMAL
+ *   OUTPUTS: none
+ *   RETURN VALUE: 0 on success, -1 on a free pid, a kernel thread or bad arguments
+ *   SIDE EFFECTS: the caller may be preempted right away when it lowers itself
+ */
+int32_t kernel_setscheduler()
+{
+    int32_t pid;
+    int32_t policy;
+    int32_t rt_priority;
+    proc_t* p;
+    asm ("			    \
+	    movl %%ebx, %0         ;\
+	    movl %%ecx, %1         ;\
+	    movl %%edx, %2         ;\
+	    "
+	    :"=g"(pid),"=g"(policy),"=g"(rt_priority)
+	    : /* no inputs */
+	    :"cc","memory"
+	);
+    if (pid == 0)
+	pid = current_proc->pid;
+    if (pid <= 0 || pid >= MAX_PIDS_IN_BITMAP || (pid_htable.bitmap & (1 << pid)) == 0)
 	return -1;
-    inode_t* elf_inode   = (inode_t*)((process_entry.inode_num + 1)*BLOCK_SIZE + (uint8_t*)fs_img_addr); // + 1 for offset of bootblock
-    uint8_t* start_elf = (boot_block->num_inodes + 1 + elf_inode->data_blocks[0])*BLOCK_SIZE + (uint8_t*)fs_img_addr; // + 1 for offset of bootblock
-    if ((start_elf[0] == ELF_MAGIC_WORD_0) &&
-	    (start_elf[1] == ELF_MAGIC_WORD_1) &&
-	    (start_elf[2] == ELF_MAGIC_WORD_2) &&
-	    (start_elf[3] == ELF_MAGIC_WORD_3))
+    p = &pid_htable.pids[pid].pcb;
+    if (p->is_kthread || p->state == TASK_ZOMBIE || policy < 0 || rt_priority < 0 || rt_priority > RT_MAX_PRIO)
+	return -1;
+    return sched_setscheduler(p, (uint8_t)policy, (uint8_t)rt_priority);
+}
+
+/*
+ * kernel_null
+ *   DESCRIPTION: does nothing, the cost of calling it is the cost of
+ *                entering and leaving the kernel
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: 0
+ *   SIDE EFFECTS: none
+ */
+int32_t kernel_null()
+{
+    return 0;
+}
+
+/*
+ * kernel_multicall
+ *   DESCRIPTION: runs a batch of system calls in order with one trap,
+ *                stopping at the first one that returns -1. Calls that
+ *                never return to their caller (halt, execute) or would
+ *                nest (multicall) are refused and count as failures.
+ *   INPUTS: calls - (ebx) user array of multicall_t
+ *           count - (ecx) entries in the array, 1..MULTICALL_MAX
+ *   OUTPUTS: the result field of every entry that ran
+ *   RETURN VALUE: number of calls that succeeded, equal to count when all
+ *                 did, -1 if the array is bad
+ *   SIDE EFFECTS: those of the calls, each is counted by its own sysstat
+ */
+int32_t kernel_multicall()
+{
+    multicall_t* calls;
+    int32_t count;
+    int32_t i;
+    int32_t nr;
+    uint64_t start;
+    asm ("			    \
+	    movl %%ebx, %0         ;\
+	    movl %%ecx, %1         ;\
+	    "
+	    :"=g"(calls),"=g"(count)
+	    : /* no inputs */
+	    :"cc","memory"
+	);
+    if (count <= 0 || count > MULTICALL_MAX)
+	return -1;
+    if ((uint32_t)calls < START_OF_USER || (uint32_t)calls > (START_OF_USER + __4MB__ - count * sizeof(multicall_t)))
+	return -1;
+    for (i = 0; i < count; i++) {
+	nr = calls[i].nr;
+	if (nr <= 0 || nr >= NR_SYS_CALLS || nr == SYS_HALT || nr == SYS_EXECUTE || nr == SYS_MULTICALL) {
+	    calls[i].result = -1;
+	    break;
+	}
+	start = (tsc_khz != 0) ? rdtsc() : 0;
+	calls[i].result = do_sys_call(nr, calls[i].args[0], calls[i].args[1], calls[i].args[2]);
+	if (tsc_khz != 0)
+	    syscall_stat_add(nr, calls[i].result, rdtsc() - start);
+	if (calls[i].result == -1)
+	    break;
+    }
+    return i;
+}
+
+/*
+ * find_child
+ *   DESCRIPTION: looks for background children of parent matching pid
+ *   INPUTS: parent - process whose children to search
+ *           pid    - child to look for, -1 for any
+ *           zombie - set to a matching child that already halted, or NULL
+ *   OUTPUTS: zombie
+ *   RETURN VALUE: number of matching children, halted or not
+ *   SIDE EFFECTS: none
+ */
+static int32_t find_child(proc_t* parent, int32_t pid, proc_t** zombie)
+{
+    int16_t i;
+    int32_t n = 0;
+    proc_t* p;
+    *zombie = NULL;
+    for (i = 1; i < MAX_PIDS_IN_BITMAP; i++) {
+	if ((pid_htable.bitmap & (1 << i)) == 0)
+	    continue;
+	p = &pid_htable.pids[i].pcb;
+	if (p->parent != parent || !p->background || (pid != -1 && pid != i))
+	    continue;
+	n++;
+	if (p->state == TASK_ZOMBIE && *zombie == NULL)
+	    *zombie = p;
+    }
+    return n;
+}
+
+/*
+ * wait_child
+ *   DESCRIPTION: collects a background child of the current process, sleeping
+ *                until one halts unless WNOHANG is given
+ *   INPUTS: pid     - child to wait for, -1 for any
+ *           status  - receives the child's halt status, may be NULL
+ *           options - 0 or WNOHANG
+ *   OUTPUTS: status
+ *   RETURN VALUE: pid of the reaped child, 0 if WNOHANG found none halted yet,
+ *                 -1 if there is no such child
+ *   SIDE EFFECTS: frees the child's pid
+ */
+int32_t wait_child(int32_t pid, int32_t* status, int32_t options)
+{
+    proc_t* parent = current_proc;
+    proc_t* zombie;
+    uint32_t flags;
+    int32_t n;
+    if (pid == 0 || pid < -1)
+	return -1;
+    cli_and_save(flags); /* a child halting between the search and sleep_on must not be missed */
+    while ((n = find_child(parent, pid, &zombie)) != 0 && zombie == NULL && !(options & WNOHANG))
+	sleep_on(&child_exit_wq);
+    restore_flags(flags);
+    if (n == 0)
+	return -1;
+    if (zombie == NULL)
 	return 0;
-    else
+    if (status != NULL)
+	*status = zombie->exit_status;
+    pid = zombie->pid;
+    reap_zombie(zombie);
+    return pid;
+}
+
+/*
+ * kernel_spawn
+ *   DESCRIPTION: starts a program on a terminal and returns right away.
+ *                The child is an ordinary background child of the caller,
+ *                scheduled on its own and collected with waitpid.
+ *   INPUTS: command  - (ebx) user string, as for execute
+ *           terminal - (ecx) terminal the child reads and writes
+ *   OUTPUTS: none
+ *   RETURN VALUE: pid of the child, or of the last stage of a pipeline,
+ *                 -1 on a bad command or terminal
+ *   SIDE EFFECTS: none
+ */
+static uint8_t spawn_buf[TERMINAL_BUF_SIZE];
+int32_t kernel_spawn()
+{
+    uint8_t* command;
+    int32_t terminal;
+    int32_t i;
+    int32_t terminated = 0;
+    asm ("			    \
+	    movl %%ebx, %0         ;\
+	    movl %%ecx, %1         ;\
+	    "
+	    :"=g"(command),"=g"(terminal)
+	    : /* no inputs */
+	    :"cc","memory"
+	);
+    if ((uint32_t)command < START_OF_USER || (uint32_t)command >= START_OF_USER + __4MB__)
+	return -1;
+    if (terminal < 0 || terminal >= MAX_NUM_TERMINALS || sessions[terminal].en == 0)
+	return -1;
+    for (i = 0; i < TERMINAL_BUF_SIZE && (uint32_t)&command[i] < START_OF_USER + __4MB__; i++) {
+	spawn_buf[i] = command[i];
+	if (command[i] == '\0') {
+	    terminated = 1;
+	    break;
+	}
+    }
+    /* spawn_buf is static, a byte past the copy may be left from an earlier call */
+    if (!terminated || i == 0)
+	return -1;
+    if (is_pipeline(spawn_buf))
+	return run_pipeline(spawn_buf, terminal, 1);
+    return do_execute(spawn_buf, terminal, 1, NULL, NULL);
+}
+
+/*
+ * kernel_waitpid
+ *   DESCRIPTION: collects the halt status of a child started with execute "cmd &"
+ *   INPUTS: pid     - (ebx) child to wait for, -1 for any
+ *           status  - (ecx) user pointer receiving the halt status, may be NULL
+ *           options - (edx) 0 or WNOHANG
+ *   OUTPUTS: none
+ *   RETURN VALUE: pid of the child, 0 with WNOHANG if none halted yet,
+ *                 -1 if there is no such child or the pointer is bad
+ *   SIDE EFFECTS: may block until a child halts
+ */
+int32_t kernel_waitpid()
+{
+    int32_t pid;
+    int32_t* status;
+    int32_t options;
+    asm ("			    \
+	    movl %%ebx, %0         ;\
+	    movl %%ecx, %1         ;\
+	    movl %%edx, %2         ;\
+	    "
+	    :"=g"(pid),"=g"(status),"=g"(options)
+	    : /* no inputs */
+	    :"cc","memory"
+	);
+    if (status != NULL && ((uint32_t)status < START_OF_USER || (uint32_t)status > (START_OF_USER + __4MB__ - sizeof(int32_t))))
 	return -1;
+    return wait_child(pid, status, options);
 }
 
 #endif
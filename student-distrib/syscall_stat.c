@@ -0,0 +1,134 @@
+#ifndef SYSCALL_STAT_C
+#define SYSCALL_STAT_C
+#include "include/syscall_stat.h"
+#include "include/sys_call.h"
+#include "include/task.h"
+#include "include/sched.h"
+#include "include/clock.h"
+#include "include/lib.h"
+#include "include/vga.h"
+#include "include/spinlock.h"
+syscall_stat_t syscall_stats[NR_SYS_CALLS];
+static DEFINE_SPINLOCK(stat_lock); /* syscall_stats, updated by every task on its way out */
+/* names for show_syscall_stats, in jump table order */
+static const int8_t* syscall_names[NR_SYS_CALLS] = {
+    "", "halt", "execute", "read", "write", "open", "close", "getargs", "vidmap",
+    "set_handler", "sigreturn", "gettime", "sleep", "getrusage", "waitpid",
+    "setscheduler", "null", "sysstat", "multicall", "pipe",
+    "shmget", "shmat", "shmdt", "spawn"
+};
+/*
+ * syscall_stat_add
+ *   DESCRIPTION: charges one finished system call to its counters and
+ *                histogram under stat_lock
+ *   INPUTS: nr     - system call number
+ *           ret    - what the handler returned
+ *           cycles - latency of the call
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+void syscall_stat_add(int32_t nr, int32_t ret, uint64_t cycles)
+{
+    syscall_stat_t* st;
+    uint32_t bucket = 0;
+    if (nr <= 0 || nr >= NR_SYS_CALLS)
+	return;
+    st = &syscall_stats[nr];
+    spin_lock(&stat_lock);
+    st->count++;
+    if (ret == -1)
+	st->failed++;
+    st->cycles += cycles;
+    if (cycles > st->max_cycles)
+	st->max_cycles = cycles;
+    if ((cycles >> 31) != 0)
+	bucket = SYSCALL_HIST_BUCKETS - 1;
+    else if (cycles != 0)
+	bucket = bitscan_reverse((uint32_t)cycles);
+    st->hist[bucket]++;
+    spin_unlock(&stat_lock);
+}
+/*
+ * syscall_stat_exit
+ *   DESCRIPTION: charges a system call that returns to user space to its
+ *                counters and to the calling process
+ *   INPUTS: nr    - system call number, already range checked
+ *           ret   - what the handler returned
+ *           start - TSC at the entry of sys_call_vector
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: without a TSC only the calls of the process are counted
+ */
+void syscall_stat_exit(int32_t nr, int32_t ret, uint64_t start)
+{
+    uint64_t cycles;
+    current_proc->nsyscalls++;
+    if (tsc_khz == 0) /* clock_init found no TSC, nothing was stamped */
+	return;
+    cycles = rdtsc() - start;
+    syscall_stat_add(nr, ret, cycles);
+    current_proc->syscall_cycles += cycles;
+}
+/*
+ * kernel_sysstat
+ *   DESCRIPTION: copies the counters of one system call to user space
+ *   INPUTS: nr  - (ebx) system call number
+ *           buf - (ecx) user pointer to a syscall_stat_t
+ *   OUTPUTS: none
+ *   RETURN VALUE: 0 on success, -1 on a bad number or a pointer outside the user page
+ *   SIDE EFFECTS: none
+ */
+int32_t kernel_sysstat()
+{
+    int32_t nr;
+    syscall_stat_t* buf;
+    asm ("			    \
+	    movl %%ebx, %0         ;\
+	    movl %%ecx, %1         ;\
+	    "
+	    :"=g"(nr),"=g"(buf)
+	    : /* no inputs */
+	    :"cc","memory"
+	);
+    if ((uint32_t)buf < START_OF_USER || (uint32_t)buf > (START_OF_USER + __4MB__ - sizeof(syscall_stat_t)))
+	return -1;
+    if (nr <= 0 || nr >= NR_SYS_CALLS)
+	return -1;
+    spin_lock(&stat_lock);
+    memcpy((void*)buf, (const void*)&syscall_stats[nr], sizeof(syscall_stat_t));
+    spin_unlock(&stat_lock);
+    return 0;
+}
+/*
+ * show_syscall_stats
+ *   DESCRIPTION: prints count, failures, mean and max latency of every
+ *                system call made so far, and the most common log2 bucket,
+ *                at the current VGA position
+ *   INPUTS: none
+ *   OUTPUTS: one line per system call
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: writes to the screen selected by vga_mem_base
+ */
+void show_syscall_stats()
+{
+    syscall_stat_t* st;
+    uint64_t avg, max;
+    uint32_t nr, i, mode;
+    vga_printf("SYSCALL       CALLS  FAILED  AVG(ns)  MAX(ns)  MODE(cycles)\n");
+    for (nr = 1; nr < NR_SYS_CALLS; nr++) {
+	st = &syscall_stats[nr];
+	if (st->count == 0)
+	    continue;
+	avg = st->cycles;
+	div64_32(&avg, st->count);
+	max = st->max_cycles;
+	mode = 0;
+	for (i = 1; i < SYSCALL_HIST_BUCKETS; i++)
+	    if (st->hist[i] > st->hist[mode])
+		mode = i;
+	vga_printf("%s  %u  %u  %u  %u  2^%u\n", syscall_names[nr], st->count, st->failed,
+		   (uint32_t)cycles_to_ns(avg), (uint32_t)cycles_to_ns(max), mode);
+    }
+}
+#endif
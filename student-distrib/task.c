@@ -8,13 +8,12 @@
 #include "include/memory.h"
 #include "include/lib.h"
 #include "include/sched.h"
+#include "include/pipe.h"
 volatile int16_t next_pid = 0; /* next available PID */
 volatile int16_t curr_pid = 0; /* current PID        */
 pid_htable_t pid_htable;
 proc_t* idle;                /* ptr to idle process (PID = 0)   */
 proc_t* kern;                /* ptr to kernel process (PID = 0) */
-queue_t active_tasks;
-queue_t* current_queue;
 /*
  *
  * init_idle_task
@@ -26,8 +25,6 @@ queue_t* current_queue;
  */
 void init_idle_task()
 {
-    current_queue = &runqueue.active_array->tasks[0];
-    current_queue->ops  = &queue_ops_table;
     kern = (proc_t*)&pid_htable.pids[KERNEL_PID].pcb;
     set_curr_file_table(0);
     kern->open_files = curr_file_table;
@@ -43,12 +40,15 @@ void init_idle_task()
     SAVE_REGS(kern->kernel_regs);
     kern->state = TASK_RUNNING;
     kern->num_open_files = 0;
+    memcpy((void*)kern->command, (const void*)"idle", sizeof("idle"));
+    init_task_stats(kern);
     pid_htable.pids[KERNEL_PID].pcb  = *kern;
     kern->kernel_regs.esp = __4MB__;
     kern->kernel_regs.ebp = __4MB__;
     idle = kern;
     tss.ss0 = KERNEL_DS;
     tss.esp0 = (uint32_t)idle->kernel_regs.esp; /* set up first stack */
+    idle->thread.esp0 = tss.esp0; /* thread.esp is filled in by the first switch_to */
     tss.esp1 = (uint32_t)idle->kernel_regs.esp + __512KB__; /* set up second stack */
     SAVE_ESP(idle->kernel_regs); /* save ESP */
     SAVE_EBP(idle->kernel_regs); /* save EBP */
@@ -76,10 +76,8 @@ proc_t* mk_proc(uint8_t* command, uint8_t* args)
 	return NULL;
     pid_t* htable_entry = &pid_htable.pids[next_pid];// get_next_free_htable_entry();
     proc_t*        pcb  = &htable_entry->pcb;
-    htable_entry->node = (list_head_t*)ll_alloc();
-    htable_entry->node->next = NULL;
-    htable_entry->node->prev = NULL;
-    htable_entry->node->entry = (void*)htable_entry;
+    INIT_LIST_HEAD(&pcb->tty_list); /* linked into its terminal's chain by execute */
+    INIT_LIST_HEAD(&pcb->wait_list);
     //curr_pid = next_free_pid();
     pcb->pid = next_pid;
     set_entry_by_index(pid_htable, pcb->pid);
@@ -99,6 +97,13 @@ proc_t* mk_proc(uint8_t* command, uint8_t* args)
     pcb->entry_point = 0; // default value
     pcb->stack_addr  = 0; // default
     pcb->is_vidmapped = 0;		 /* default */
+    pcb->priority     = REGULAR_PRIO;	 /* default scheduling class */
+    pcb->background   = 0;		 /* execute suspends the parent unless asked otherwise */
+    pcb->policy       = SCHED_NORMAL;
+    pcb->wake_boost   = 0;
+    pcb->rt_priority  = 0;
+    pcb->exit_status  = 0;
+    init_task_stats(pcb);
     pcb->num_open_files = 0;
     memcpy((int8_t*)pcb->command, (const int8_t*)command,strlen((const int8_t*)command)+1); // Plus one is for the NULL char
     memcpy((int8_t*)pcb->args, (int8_t*)args,strlen((const int8_t*)args)+1); // Plus one is for the NULL char
@@ -117,11 +122,24 @@ void close_proc(proc_t* proc)
 {
     if (proc == NULL) /* validate input */
 	return;
-    pid_t* htable_entry = &pid_htable.pids[proc->pid]; /* pointer to table entry containing process resources */
-    if (htable_entry == NULL)
-    	return;
-
-    ll_free(htable_entry->node); /* reclaim memory allocated to list node */
+    exit_proc(proc);
+    release_proc(proc);
+}
+/*
+ * exit_proc
+ *   DESCRIPTION: Releases what a finished process owns while it is still a
+ *                zombie: its file table and FPU state. The pid, and with it
+ *                the user page and kernel stack, stay reserved until
+ *                release_proc.
+ *   INPUTS: proc: process that stopped running
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: Closes every open file of the process
+ */
+void exit_proc(proc_t* proc)
+{
+    if (proc == NULL) /* validate input */
+	return;
     set_curr_file_table(proc->file_table_num); /* point current file table to process file table */
     file_table_t* files = curr_file_table;
     if (files != NULL) {
@@ -131,30 +149,49 @@ void close_proc(proc_t* proc)
 		if (&file[pos] == NULL) {
 		    continue;
 		}
-		fs_t* file = &file[pos];
-		file->op_ptr    = NULL;
-		file->buffer    = NULL;
-		file->sess      = NULL;
-		file->inode     = NULL;
-		file->inode_num = 0;
-		file->f_pos     = 0;
-		file->flags     = 0;
+		fs_t* f = &file[pos];
+		pipe_release(f);          /* the other end sees EOF or a broken pipe */
+		f->op_ptr    = NULL;
+		f->buffer    = NULL;
+		f->sess      = NULL;
+		f->inode     = NULL;
+		f->inode_num = 0;
+		f->f_pos     = 0;
+		f->flags     = 0;
 		files->bitmap &= ~(1 << pos);
 	    }
     }
     files->bitmap        = 0; /* clear file bitmap */
     file_table_bitmap   &= ~(1 << proc->file_table_num); /* clear file table bitmap entry */
     proc->file_table_num = 0; /* clear file table number field */
-    clear_entry_by_index(pid_htable, proc->pid);
     proc->open_files     = NULL; /* disassociate pcb from file table instance */
     proc->num_open_files = 0;
+    proc->is_vidmapped   = 0; /* clear is_vidmapped flag */
+    shm_exit(proc);              /* unmap shared memory segments */
+    fpu_release(proc);           /* drop any live FPU state */
+}
+/*
+ * release_proc
+ *   DESCRIPTION: Frees the pid of a process released by exit_proc, the
+ *                last step of halt or of reaping a zombie
+ *   INPUTS: proc: process to free
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: The pid may be handed out again right away
+ */
+void release_proc(proc_t* proc)
+{
+    if (proc == NULL)
+	return;
+    clear_entry_by_index(pid_htable, proc->pid);
     // proc->user_regs      = *((regs_t*)NULL);
     // proc->kernel_regs    = *((regs_t*)NULL);
     proc->entry_point    = 0; /* clear entries */
     proc->pid            = 0; /*      |        */
     proc->active         = 0; /*      V        */
     proc->state          = TASK_STOPPED; /* update state */
-    proc->is_vidmapped   = 0; /* clear is_vidmapped flag */
+    proc->parent         = NULL;
+    proc->background     = 0;
     memset((void*)proc->command, NULL, CMD_NAME_MAX_LEN); /* clear command 
 							     and args fields */
     memset((void*)proc->args, NULL, CMD_ARGS_MAX_LEN);
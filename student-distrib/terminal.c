@@ -7,10 +7,13 @@
 #include "include/memory.h"
 terminal_session_t sessions[MAX_NUM_TERMINALS];
 uint8_t session_buffers[MAX_NUM_TERMINALS][TERMINAL_BUF_SIZE];
+struct list_head term_queues[MAX_NUM_TERMINALS]; /* per terminal chain of processes, first is the base shell */
+wait_queue_t term_read_wqs[MAX_NUM_TERMINALS]; /* per terminal readers waiting for enter */
 uint32_t current_session = 0;
 int session_counter = 0;
 uint8_t terminal_reading = 0;
 uint8_t shell_showing = 1;
+DEFINE_SPINLOCK(tty_lock);
 static uint8_t session_colors[] = { (BLACK <<4) + WHITE,
  														        (GREEN << 4) + BLACK,
 													          (WHITE << 4) + RED
@@ -48,15 +51,10 @@ void clear_terminal_buffer(int32_t id)
  */
 int32_t terminal_write(int32_t fd, uint8_t* buffer, uint32_t length)
 {
-  cli();
   int i;
   int num_char_2_screen= 0;
   // pid_t* hpid = get_current_htable_entry();
   // proc_t* current_pcb = &hpid->pcb;
-  if(current_proc->terminal_id == current_session)
-    vga_mem_base = VIDEO_MEM_START;
-  else
-    vga_mem_base = (uint32_t)sessions[current_proc->terminal_id].vga.screen_start;
   if (current_proc == NULL)
       return -1;
   if (sessions[current_proc->terminal_id].en == 0)
@@ -65,6 +63,11 @@ int32_t terminal_write(int32_t fd, uint8_t* buffer, uint32_t length)
       return -1;
   if(buffer == NULL)
       return -1;
+  spin_lock(&tty_lock);
+  if(current_proc->terminal_id == current_session)
+    vga_mem_base = VIDEO_MEM_START;
+  else
+    vga_mem_base = (uint32_t)sessions[current_proc->terminal_id].vga.screen_start;
   for(i = 0; i<length;i++)
   {
       if(*(buffer+i) != NULL) // Do not print NULL characters
@@ -74,7 +77,7 @@ int32_t terminal_write(int32_t fd, uint8_t* buffer, uint32_t length)
 	  num_char_2_screen++;
       }
   }
-  sti();
+  spin_unlock(&tty_lock);
   return num_char_2_screen;
 }
 /*
@@ -136,8 +139,9 @@ int32_t terminal_read(int32_t id, uint8_t* buffer, uint32_t length)
     if (sessions[current_proc->terminal_id].en == 0)
 	return -1;
     terminal_reading = 1;
-    while(sessions[current_proc->terminal_id].enter == 0);
-    cli();
+    /* sleep until the keyboard handler sees enter on this terminal */
+    wait_event(*sessions[current_proc->terminal_id].read_wq, sessions[current_proc->terminal_id].enter != 0);
+    spin_lock(&tty_lock); /* the keyboard worker fills the buffer under it */
     if(length < sessions[current_proc->terminal_id].index)
 	num_to_copy = length;
     else
@@ -154,7 +158,7 @@ int32_t terminal_read(int32_t id, uint8_t* buffer, uint32_t length)
 	buffer[num_to_copy] = '\n';
     }
     terminal_reading = 0;
-    sti();
+    spin_unlock(&tty_lock);
     return num_to_copy;
 }
 
@@ -195,6 +199,8 @@ void init_terminal(int32_t number)
 	sessions[number].vga.x_pos = 0;
 	sessions[number].vga.y_pos = 0;
 	sessions[number].queue     = NULL;
+	sessions[number].read_wq   = &term_read_wqs[number];
+	init_waitqueue(sessions[number].read_wq);
 	current_session = number;
 
 	//save_term_vga_state();
@@ -255,13 +261,12 @@ uint8_t parse_user_input(uint8_t* input, int length)
  *  INPUTS     : term_to_switch   -- the terminal to be showen
  *  OUTPUTS      : none
  *  RETURN VALUE : none
- *  SIDE EFFECTS : changes the shown terminal to the one selected
+ *  SIDE EFFECTS : changes the shown terminal to the one selected, caller holds tty_lock
  */
 void term_switch(uint32_t term_to_switch)
 {
-    cli();
     if(term_to_switch == current_session || MAX_NUM_TERMINALS <= term_to_switch) // No switch if the terminal to switch to is the same
-	     return;
+	return;
     // Save the current screen of the current session
     terminal_session_t*  current_term = &sessions[current_session];
     terminal_session_t*  next_term    = &sessions[term_to_switch];
@@ -279,12 +284,11 @@ void term_switch(uint32_t term_to_switch)
     restore_vga_state(&(next_term->vga));
 
     //If the shell is showing then a special ctr_l is used in the vga
-    uint8_t* showen_proc_command =  ((pid_t*)(next_term->queue->last->entry))->pcb.command;
+    uint8_t* showen_proc_command =  list_last_entry(next_term->queue, proc_t, tty_list)->command;
     if(strncmp( (const int8_t*)showen_proc_command , "shell", strlen((int8_t*) showen_proc_command)) == 0)
       shell_showing = 1;
     else
       shell_showing = 0;
-    sti();
     return;
 }
 
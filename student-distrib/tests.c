@@ -15,6 +15,17 @@
 #include "include/sys_call.h"
 #include "include/vga.h"
 #include "include/sys.h"
+#include "include/sched.h"
+#include "include/clock.h"
+#include "include/timer.h"
+#include "include/fpu.h"
+#include "include/vdso.h"
+#include "include/syscall_stat.h"
+#include "include/pipe.h"
+#include "include/shm.h"
+#include "include/exec_cache.h"
+#include "include/workqueue.h"
+#include "include/kthread.h"
 #define PASS 1
 #define FAIL 0
 #define TEST_CASE_BUF 15
@@ -942,9 +953,822 @@ int vm_alloc_tests()
 }
 int test_terminal_switching()
 {
+    spin_lock(&tty_lock);
     term_switch(1);
+    spin_unlock(&tty_lock);
 		return 0;
 }
+/* sched_prio_array_test
+ *
+ * Queues two scratch tasks of different classes on the runqueue and checks
+ * that the bitmap tracks their priority lists
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: NONE
+ * Coverage: O(1) scheduler
+ */
+int sched_prio_array_test()
+{
+    TEST_HEADER;
+    int result = PASS;
+    uint32_t flags;
+    proc_t* rt  = &pid_htable.pids[MAX_PIDS-1].pcb; /* slots never handed out by the pid bitmap */
+    proc_t* reg = &pid_htable.pids[MAX_PIDS-2].pcb;
+    uint32_t n_runnable = runqueue.n_runnable;
+    prio_array_t* active = runqueue.active_array;
+    cli_and_save(flags);
+    rt->pid = MAX_PIDS-1;
+    rt->priority = REAL_TIME_PRIO;
+    reg->pid = MAX_PIDS-2;
+    reg->priority = REGULAR_PRIO;
+    activate_task(reg);
+    activate_task(rt);
+    if (runqueue.n_runnable != n_runnable + 2)
+	result = FAIL;
+    if ((active->bitmap[rt->prio / 32] & (1 << (rt->prio % 32))) == 0)
+	result = FAIL;
+    if (active->tasks[rt->prio].next != &rt->run_list || rt->prio >= reg->prio)
+	result = FAIL;
+    deactivate_task(rt);
+    deactivate_task(reg);
+    if (!list_empty(&active->tasks[rt->prio]) || rt->array != NULL)
+	result = FAIL;
+    if ((active->bitmap[rt->prio / 32] & (1 << (rt->prio % 32))) != 0)
+	result = FAIL;
+    if (runqueue.n_runnable != n_runnable)
+	result = FAIL;
+    rt->pid = 0;
+    reg->pid = 0;
+    restore_flags(flags);
+    return result;
+}
+/* clock_math_test
+ *
+ * Checks the 64 bit division helper and the timespec conversion, and that
+ * the clock does not run backwards
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: NONE
+ * Coverage: clock
+ */
+int clock_math_test()
+{
+    TEST_HEADER;
+    int result = PASS;
+    uint64_t n = ((uint64_t)7 << 32) + 5;
+    timespec_t ts;
+    uint64_t t0, t1;
+    if (div64_32(&n, 10) != 7 || n != (((uint64_t)7 << 32) + 5) / 10)
+	result = FAIL;
+    ns_to_timespec((uint64_t)3 * NSEC_PER_SEC + 42, &ts);
+    if (ts.tv_sec != 3 || ts.tv_nsec != 42)
+	result = FAIL;
+    t0 = clock_ns();
+    t1 = clock_ns();
+    if (t1 < t0)
+	result = FAIL;
+    return result;
+}
+static void timer_test_fn(uint32_t data)
+{
+    *(uint32_t*)data += 1;
+}
+/* timer_wheel_test
+ *
+ * Arms timers in the root and an outer level of the wheel and cancels them
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: NONE
+ * Coverage: timer wheel
+ */
+int timer_wheel_test()
+{
+    TEST_HEADER;
+    int result = PASS;
+    uint32_t fired = 0;
+    timer_list_t near, far;
+    init_timer(&near);
+    init_timer(&far);
+    near.function = far.function = timer_test_fn;
+    near.data = far.data = (uint32_t)&fired;
+    near.expires = jiffies + 10;
+    far.expires  = jiffies + TVR_SIZE * 4;
+    add_timer(&near);
+    add_timer(&far);
+    if (near.bucket == NULL || far.bucket == NULL || near.bucket == far.bucket)
+	result = FAIL;
+    if (timer_next_expiry(0) == 0)
+	result = FAIL;
+    if (del_timer(&near) != 1 || del_timer(&near) != 0)
+	result = FAIL;
+    if (del_timer(&far) != 1 || far.bucket != NULL)
+	result = FAIL;
+    if (fired != 0)
+	result = FAIL;
+    return result;
+}
+/* fpu_lazy_test
+ *
+ * Checks fxsave area alignment and that touching SSE with TS set hands the
+ * FPU to the current task through #NM
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: current task becomes the FPU owner
+ * Coverage: lazy FPU switching
+ */
+int fpu_lazy_test()
+{
+    TEST_HEADER;
+    int result = PASS;
+    uint32_t cr0;
+    if (((uint32_t)&pid_htable.pids[1].pcb.fpu & (FXSAVE_ALIGN - 1)) != 0)
+	result = FAIL;
+    if ((uint32_t)&current_proc->thread != (uint32_t)current_proc)
+	result = FAIL;
+    if (!fpu_enabled)
+	return result;
+    fpu_release(current_proc);
+    stts();
+    asm volatile("xorps %%xmm0, %%xmm0" ::: "memory"); /* traps to math_state_restore */
+    asm volatile("movl %%cr0, %0" : "=r"(cr0));
+    if (fpu_owner != current_proc || !current_proc->used_math || (cr0 & CR0_TS))
+	result = FAIL;
+    return result;
+}
+static void work_test_fn(uint32_t data)
+{
+    *(volatile uint32_t*)data += 1;
+}
+/* workqueue_test
+ *
+ * Queues a work item twice and waits for the events worker to run it once
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: NONE
+ * Coverage: kernel threads, workqueue
+ */
+int workqueue_test()
+{
+    TEST_HEADER;
+    int result = PASS;
+    volatile uint32_t ran = 0;
+    uint32_t i;
+    work_t work = { NULL, work_test_fn, (uint32_t)&ran, 0 };
+    if (events_wq.worker == NULL || !events_wq.worker->is_kthread)
+	return FAIL;
+    cli();
+    if (queue_work(&events_wq, &work) != 1 || queue_work(&events_wq, &work) != 0)
+	result = FAIL;
+    sti();
+    for (i = 0; i < 100 && ran == 0; i++)
+	asm volatile("hlt");
+    if (ran != 1 || work.pending)
+	result = FAIL;
+    return result;
+}
+/* rusage_test
+ *
+ * Checks that accounting snapshots are filled in and only grow
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: NONE
+ * Coverage: CPU accounting
+ */
+int rusage_test()
+{
+    TEST_HEADER;
+    int result = PASS;
+    rusage_t a, b;
+    uint32_t i;
+    if (fill_rusage(current_proc, &a) != 0 || fill_rusage(NULL, &a) != -1)
+	return FAIL;
+    for (i = 0; i < 4; i++)
+	asm volatile("hlt");
+    fill_rusage(current_proc, &b);
+    if (a.pid != current_proc->pid || b.exec_ms < a.exec_ms)
+	result = FAIL;
+    if (b.utime_ms + b.stime_ms < a.utime_ms + a.stime_ms)
+	result = FAIL;
+    return result;
+}
+/* spinlock_test
+ *
+ * Checks ticket lock hand out, trylock and the preempt count
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: NONE
+ * Coverage: spinlocks
+ */
+int spinlock_test()
+{
+    TEST_HEADER;
+    int result = PASS;
+    spinlock_t lock;
+    uint32_t flags, eflags;
+    int32_t count = preempt_count;
+    spin_lock_init(&lock, (const int8_t*)"test");
+    if (spin_is_locked(&lock) || !spin_trylock(&lock))
+	return FAIL;
+    if (!spin_is_locked(&lock) || spin_trylock(&lock) || preemptible())
+	result = FAIL;
+    spin_unlock(&lock);
+    if (spin_is_locked(&lock) || preempt_count != count)
+	result = FAIL;
+    spin_lock_irqsave(&lock, flags);
+    asm volatile("pushfl; popl %0" : "=r"(eflags));
+    if ((eflags & EFLAGS_IF) || TICKET_NEXT(lock.slock) != 2 || TICKET_OWNER(lock.slock) != 1)
+	result = FAIL;
+    spin_unlock_irqrestore(&lock, flags);
+    if (spin_is_locked(&lock) || preempt_count != count)
+	result = FAIL;
+    return result;
+}
+/* list_test
+ *
+ * Checks add, delete, splice and list_entry of the intrusive list
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: NONE
+ * Coverage: list.h
+ */
+int list_test()
+{
+    TEST_HEADER;
+    int result = PASS;
+    struct { int32_t v; list_head_t link; } a, b, c; /* entries of a list */
+    LIST_HEAD(first);
+    LIST_HEAD(second);
+    if (!list_empty(&first))
+	return FAIL;
+    list_add_tail(&a.link, &first);
+    list_add_tail(&b.link, &first);
+    list_add(&c.link, &second);
+    if (list_first_entry(&first, typeof(a), link) != &a || list_last_entry(&first, typeof(a), link) != &b)
+	result = FAIL;
+    list_del_init(&a.link);
+    if (!list_empty(&a.link) || list_first_entry(&first, typeof(a), link) != &b)
+	result = FAIL;
+    list_splice_tail_init(&second, &first);
+    if (!list_empty(&second) || list_last_entry(&first, typeof(a), link) != &c || b.link.next != &c.link)
+	result = FAIL;
+    list_del(&b.link);
+    list_del(&c.link);
+    if (!list_empty(&first))
+	result = FAIL;
+    return result;
+}
+/* waitpid_test
+ *
+ * Checks waitpid on a fake background child, running and then a zombie
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: borrows a free pid for the duration of the test
+ * Coverage: waitpid, zombie reaping
+ */
+int waitpid_test()
+{
+    TEST_HEADER;
+    int result = PASS;
+    int32_t status = 0;
+    int16_t pid = next_free_pid();
+    proc_t* child;
+    if (pid < 1 || pid >= MAX_PIDS_IN_BITMAP)
+	return FAIL;
+    if (wait_child(-1, &status, WNOHANG) != -1) /* no background children yet */
+	result = FAIL;
+    set_entry_by_index(pid_htable, pid);
+    child = &pid_htable.pids[pid].pcb;
+    child->pid        = pid;
+    child->parent     = current_proc;
+    child->background = 1;
+    child->state      = TASK_RUNNING;
+    nr_tasks += 1;
+    if (wait_child(pid, &status, WNOHANG) != 0)
+	result = FAIL;
+    child->state       = TASK_ZOMBIE;
+    child->exit_status = 42;
+    if (wait_child(-1, &status, 0) != pid || status != 42)
+	result = FAIL;
+    if ((pid_htable.bitmap & (1 << pid)) != 0 || wait_child(pid, &status, WNOHANG) != -1)
+	result = FAIL;
+    return result;
+}
+/* rt_sched_test
+ *
+ * Moves a scratch task between the normal and real time classes and checks
+ * its priority list and the real time count of the active array
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: NONE
+ * Coverage: SCHED_FIFO/SCHED_RR, sched_setscheduler
+ */
+int rt_sched_test()
+{
+    TEST_HEADER;
+    int result = PASS;
+    uint32_t flags;
+    proc_t* p = &pid_htable.pids[MAX_PIDS-1].pcb; /* slot never handed out by the pid bitmap */
+    prio_array_t* active = runqueue.active_array;
+    uint32_t n_rt = active->n_rt;
+    cli_and_save(flags);
+    p->pid = MAX_PIDS-1;
+    p->priority = REGULAR_PRIO;
+    p->policy = SCHED_NORMAL;
+    p->rt_priority = 0;
+    activate_task(p);
+    if (sched_setscheduler(p, SCHED_FIFO, 0) != -1 || sched_setscheduler(p, SCHED_RR + 1, 1) != -1)
+	result = FAIL;
+    if (sched_setscheduler(p, SCHED_FIFO, 10) != 0 || p->prio != RT_PL - 1 - 10 || active->n_rt != n_rt + 1)
+	result = FAIL;
+    if (active->tasks[p->prio].prev != &p->run_list || p->array != active)
+	result = FAIL;
+    if (sched_setscheduler(p, SCHED_NORMAL, 0) != 0 || rt_prio(p->prio) || active->n_rt != n_rt)
+	result = FAIL;
+    deactivate_task(p);
+    p->pid = 0;
+    restore_flags(flags);
+    return result;
+}
+/* interactive_boost_test
+ *
+ * Checks the priority list of a scratch task in the foreground terminal, a
+ * background terminal and right after a keyboard wake up
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: NONE
+ * Coverage: foreground and keyboard wake boosts
+ */
+int interactive_boost_test()
+{
+    TEST_HEADER;
+    int result = PASS;
+    uint32_t flags;
+    uint8_t fg, bg;
+    proc_t* p = &pid_htable.pids[MAX_PIDS-1].pcb; /* slot never handed out by the pid bitmap */
+    cli_and_save(flags);
+    p->pid = MAX_PIDS-1;
+    p->priority = REGULAR_PRIO;
+    p->policy = SCHED_NORMAL;
+    p->is_kthread = 0;
+    p->wake_boost = 0;
+    p->terminal_id = current_session;
+    activate_task(p);
+    fg = p->prio;
+    deactivate_task(p);
+    p->terminal_id = (current_session + 1) % MAX_NUM_TERMINALS;
+    activate_task(p);
+    bg = p->prio;
+    deactivate_task(p);
+    if (fg != REGULAR_PRIO_INDEX - FG_BOOST || bg != REGULAR_PRIO_INDEX)
+	result = FAIL;
+    p->wake_boost = 1;
+    activate_task(p);
+    if (p->prio != WAKE_BOOST_INDEX)
+	result = FAIL;
+    deactivate_task(p);
+    if (p->wake_boost != 0)
+	result = FAIL;
+    p->pid = 0;
+    restore_flags(flags);
+    return result;
+}
+/* syscall_bench
+ *
+ * Runs sysbench_user as a background child in ring 3, where sysexit can
+ * return to. The child writes its results into a pipe on descriptor 1,
+ * they are read here before it halts
+ * Inputs: cycles - receives the TSC cycles of one null syscall through
+ *                  int $0x80, then through the stub page
+ * Outputs: 0 on success, -1 if the child could not be started or died
+ * Side Effects: starts and reaps a background task
+ */
+static int32_t syscall_bench(uint32_t* cycles)
+{
+    proc_t* p;
+    pipe_t* results;
+    uint32_t total[2];
+    uint32_t pde;
+    int32_t pid, status, n;
+    uint32_t got = 0;
+    if (nr_tasks >= MAX_PROCESSES || (results = pipe_create()) == NULL)
+	return -1;
+    preempt_disable();
+    p = mk_proc((uint8_t*)"sysbench", (uint8_t*)"");
+    if (p == NULL) {
+	preempt_enable();
+	pipe_put(results, PIPE_READ_END);
+	pipe_put(results, PIPE_WRITE_END);
+	return -1;
+    }
+    pid           = p->pid;
+    p->parent     = current_proc;
+    p->background = 1;
+    p->is_kthread = 0;
+    p->state      = TASK_RUNNING;
+    p->entry_point = USER_CODE_LOAD_ADDR;
+    pipe_attach(&p->open_files->files[1], results, PIPE_WRITE_END); /* the child takes this reference */
+    set_curr_file_table(current_proc->file_table_num);
+    /* load the code into the child's user page, then put ours back */
+    pde = page_directory.directory_table[START_OF_USER >> PMD_SHIFT];
+    __map_page_directory(PHYS_ADDR_START(pid), START_OF_USER, PRESENT | RW_EN | USER_EN | EXTENDED_PAGING);
+    flush_tlb();
+    memcpy((void*)USER_CODE_LOAD_ADDR, sysbench_user, sysbench_user_end - sysbench_user);
+    page_directory.directory_table[START_OF_USER >> PMD_SHIFT] = pde;
+    flush_tlb();
+    init_task_context(p, p->entry_point);
+    nr_tasks += 1;
+    activate_task(p);
+    preempt_enable();
+    while (got < sizeof(total) &&
+	   (n = pipe_do_read(results, (uint8_t*)total + got, sizeof(total) - got)) > 0)
+	got += n;
+    pipe_put(results, PIPE_READ_END);
+    if (wait_child(pid, &status, 0) != pid || status != 0 || got != sizeof(total))
+	return -1;
+    cycles[0] = total[0] / SYSCALL_BENCH_ITERS;
+    cycles[1] = total[1] / SYSCALL_BENCH_ITERS;
+    return 0;
+}
+/* sysenter_test
+ *
+ * Checks the SYSENTER MSRs and the null syscall, then runs the null
+ * syscall benchmark in ring 3 and prints the cycles of both entry paths
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: starts and reaps a background task
+ * Coverage: sysenter_init, sysenter_entry, sysexit return, sys_call_trap
+ */
+int sysenter_test()
+{
+    TEST_HEADER;
+    int result = PASS;
+    uint32_t cycles[2];
+    if (nullcall() != 0)
+	result = FAIL;
+    if (sysenter_enabled && (rdmsr(MSR_SYSENTER_CS) != KERNEL_CS || rdmsr(MSR_SYSENTER_EIP) != (uint32_t)sysenter_entry ||
+			     rdmsr(MSR_SYSENTER_ESP) != (uint32_t)&tss))
+	result = FAIL;
+    if (syscall_bench(cycles) != 0)
+	return FAIL;
+    vga_printf("null syscall: int $0x80 %u cycles, %s %u cycles\n", cycles[0],
+	       sysenter_enabled ? "sysenter" : "stub page", cycles[1]);
+    if (sysenter_enabled && cycles[1] >= cycles[0])
+	result = FAIL;
+    return result;
+}
+/* vdso_test
+ *
+ * Calls the user functions of the vDSO page directly, the pages are user
+ * readable and ring 0 may run them too, and compares them with the kernel
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: NONE
+ * Coverage: vdso_init, vdso_set_task, vdso_tick, vdso_text
+ */
+int vdso_test()
+{
+    TEST_HEADER;
+    int result = PASS;
+    uint32_t flags;
+    uint64_t before, ns, after;
+    timespec_t ts;
+    cli_and_save(flags); /* no switch or tick between the two reads */
+    if (vdso_getpid() != current_proc->pid || vdso_getterminal() != current_proc->terminal_id ||
+	vdso_getticks() != jiffies)
+	result = FAIL;
+    restore_flags(flags);
+    before = clock_ns();
+    ns     = vdso_clock_ns();
+    after  = clock_ns();
+    if (ns < before || ns > after)
+	result = FAIL;
+    if (vdso_gettime(&ts) != 0 || ts.tv_nsec < 0 || ts.tv_nsec >= NSEC_PER_SEC)
+	result = FAIL;
+    return result;
+}
+/* syscall_stat_test
+ *
+ * Makes three null system calls and checks they were counted, binned in
+ * the histogram and charged to the caller, and that sysstat refuses a
+ * kernel pointer
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: NONE
+ * Coverage: syscall_stat_exit, kernel_sysstat
+ */
+int syscall_stat_test()
+{
+    TEST_HEADER;
+    int result = PASS;
+    syscall_stat_t* st = &syscall_stats[SYS_NULL];
+    uint32_t count = st->count;
+    uint32_t calls = current_proc->nsyscalls;
+    uint32_t binned = 0;
+    uint32_t i;
+    syscall_stat_t copy;
+    for (i = 0; i < 3; i++)
+	nullcall();
+    if (st->count != count + 3 || current_proc->nsyscalls != calls + 3 || st->max_cycles == 0)
+	result = FAIL;
+    for (i = 0; i < SYSCALL_HIST_BUCKETS; i++)
+	binned += st->hist[i];
+    if (binned != st->count)
+	result = FAIL;
+    if (sysstat(SYS_NULL, &copy) != -1) /* not in the user page */
+	result = FAIL;
+    return result;
+}
+/* multicall_test
+ *
+ * Runs the null call through do_sys_call and checks that multicall
+ * refuses empty, oversized and kernel-space batches
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: NONE
+ * Coverage: do_sys_call, kernel_multicall argument checks
+ */
+int multicall_test()
+{
+    TEST_HEADER;
+    int result = PASS;
+    multicall_t calls[2];
+    uint32_t count = syscall_stats[SYS_NULL].count;
+    if (do_sys_call(SYS_NULL, 0, 0, 0) != 0)
+	result = FAIL;
+    calls[0].nr = SYS_NULL;
+    calls[1].nr = SYS_NULL;
+    if (multicall(calls, 0) != -1 || multicall(calls, MULTICALL_MAX + 1) != -1)
+	result = FAIL;
+    if (multicall(calls, 2) != -1) /* not in the user page */
+	result = FAIL;
+    if (syscall_stats[SYS_NULL].count != count) /* nothing ran through the batch */
+	result = FAIL;
+    return result;
+}
+/* pipe_test
+ *
+ * Streams more than a buffer's worth of data through a pipe in chunks,
+ * then checks EOF without writers and the broken pipe without readers
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: NONE
+ * Coverage: pipe_create, pipe_do_read, pipe_do_write, pipe_put
+ */
+int pipe_test()
+{
+    TEST_HEADER;
+    int result = PASS;
+    uint8_t chunk[PIPE_BUF_SIZE / 2 + 3];
+    uint8_t back[sizeof(chunk)];
+    uint32_t i, round;
+    pipe_t* p = pipe_create();
+    if (p == NULL)
+	return FAIL;
+    for (round = 0; round < 4; round++) { /* wraps around the end of the buffer */
+	for (i = 0; i < sizeof(chunk); i++)
+	    chunk[i] = (uint8_t)(i + round);
+	if (pipe_do_write(p, chunk, sizeof(chunk)) != sizeof(chunk))
+	    result = FAIL;
+	if (pipe_do_read(p, back, sizeof(back)) != sizeof(back))
+	    result = FAIL;
+	for (i = 0; i < sizeof(back); i++) {
+	    if (back[i] != (uint8_t)(i + round))
+		result = FAIL;
+	}
+    }
+    pipe_do_write(p, chunk, 5);
+    pipe_put(p, PIPE_WRITE_END);
+    if (pipe_do_read(p, back, sizeof(back)) != 5 || pipe_do_read(p, back, sizeof(back)) != 0)
+	result = FAIL;
+    pipe_get(p, PIPE_WRITE_END);
+    pipe_put(p, PIPE_READ_END);
+    if (pipe_do_write(p, chunk, 1) != -1)
+	result = FAIL;
+    pipe_put(p, PIPE_WRITE_END);
+    if (p->in_use)
+	result = FAIL;
+    return result;
+}
+/* shm_test
+ *
+ * Maps a segment twice into the current process, checks that both
+ * mappings see the same bytes and hold a frame reference each, and that
+ * the segment goes away with its last mapping
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: NONE
+ * Coverage: shm_get, shm_attach, shm_detach, shm_switch
+ */
+int shm_test()
+{
+    TEST_HEADER;
+    int result = PASS;
+    int32_t id = shm_get("shm_test", __4KB__ + 1);
+    int32_t a, b;
+    if (id == -1 || shm_get("shm_test", 2 * __4KB__) != id || shm_get("shm_test", 3 * __4KB__) != -1)
+	return FAIL;
+    a = shm_attach(current_proc, id, 0);
+    b = shm_attach(current_proc, id, USER_SHM_ADDR + 8 * __4KB__);
+    if (a != USER_SHM_ADDR || b != USER_SHM_ADDR + 8 * __4KB__)
+	result = FAIL;
+    if (shm_attach(current_proc, id, USER_SHM_ADDR + __4KB__) != -1) /* overlaps a */
+	result = FAIL;
+    if (shm_attach(current_proc, id, 0xFFFFF000) != -1 ||  /* end wraps to 0 */
+	    shm_attach(current_proc, id, USER_SHM_ADDR + (SHM_WINDOW_PAGES - 1) * __4KB__) != -1) /* runs off the window */
+	result = FAIL;
+    if (result == PASS) {
+	((uint32_t*)a)[1024 + 7] = 0xCAFEF00D;
+	if (((uint32_t*)b)[1024 + 7] != 0xCAFEF00D)
+	    result = FAIL;
+	if (shm_frame_refs(a) != 3) /* the segment and two mappings */
+	    result = FAIL;
+    }
+    shm_detach(current_proc, b);
+    shm_detach(current_proc, a);
+    if (shm_detach(current_proc, a) != -1 || shm_frame_refs(a) != -1)
+	result = FAIL;
+    if (shm_get("shm_test", 3 * __4KB__) == -1) /* gone, so it can be created larger */
+	result = FAIL;
+    a = shm_attach(current_proc, shm_get("shm_test", 1), 0);
+    shm_detach(current_proc, a);
+    return result;
+}
+/* exec_cache_test
+ *
+ * Executes "ls" through the cache twice and checks that the second lookup
+ * hits the staged image, that the text matches the file, and that an
+ * invalidated or non executable file misses
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: NONE
+ * Coverage: exec_cache_get, exec_cache_invalidate
+ */
+int exec_cache_test()
+{
+    TEST_HEADER;
+    int result = PASS;
+    static uint8_t file[EXEC_CACHE_IMAGE_SIZE];
+    exec_image_t* first = exec_cache_get((const uint8_t*)"ls");
+    exec_image_t* again;
+    uint32_t hits = exec_cache_hits;
+    uint32_t misses = exec_cache_misses;
+    uint32_t i;
+    if (first == NULL || first->data == NULL)
+	return FAIL;
+    again = exec_cache_get((const uint8_t*)"ls");
+    if (again != first || exec_cache_hits != hits + 1 || exec_cache_misses != misses)
+	result = FAIL;
+    read_data(first->inode_num, first->segs[0].offset, file, first->segs[0].filesz);
+    for (i = 0; i < first->segs[0].filesz; i++) {
+	if (file[i] != first->data[first->segs[0].staged + i])
+	    result = FAIL;
+    }
+    exec_cache_invalidate(first->inode_num);
+    if (exec_cache_get((const uint8_t*)"ls") == NULL || exec_cache_misses != misses + 1)
+	result = FAIL;
+    if (exec_cache_get((const uint8_t*)"frame0.txt") != NULL || exec_cache_get((const uint8_t*)"nosuchfile") != NULL)
+	result = FAIL;
+    return result;
+}
+/* elf_load_test
+ *
+ * Parses the program headers of "fish": a text segment holding the entry
+ * point, a data segment whose bss is zero filled, and fewer bytes staged
+ * than the file holds
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: NONE
+ * Coverage: exec_parse through exec_cache_get
+ */
+int elf_load_test()
+{
+    TEST_HEADER;
+    int result = PASS;
+    exec_image_t* e = exec_cache_get((const uint8_t*)"fish");
+    exec_segment_t* last;
+    if (e == NULL || e->nsegs != 2)
+	return FAIL;
+    last = &e->segs[e->nsegs - 1];
+    if (!(e->segs[0].flags & PF_X) || e->header.entry < e->segs[0].vaddr ||
+	    e->header.entry >= e->segs[0].vaddr + e->segs[0].memsz)
+	result = FAIL;
+    if ((last->flags & PF_X) || !(last->flags & PF_W) || last->memsz <= last->filesz)
+	result = FAIL;
+    if (last->staged + last->filesz >= e->length) /* symbols and sections are left out */
+	result = FAIL;
+    return result;
+}
+/* spawn_test
+ *
+ * Checks that spawn refuses a command outside user space and a terminal
+ * that does not exist, without starting anything
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: NONE
+ * Coverage: kernel_spawn argument checks
+ */
+int spawn_test()
+{
+    TEST_HEADER;
+    int result = PASS;
+    uint32_t tasks = nr_tasks;
+    if (spawn((const uint8_t*)"ls", 0) != -1) /* not in the user page */
+	result = FAIL;
+    if (do_sys_call(SYS_SPAWN, START_OF_USER, MAX_NUM_TERMINALS, 0) != -1 ||
+	    do_sys_call(SYS_SPAWN, START_OF_USER, -1, 0) != -1)
+	result = FAIL;
+    if (nr_tasks != tasks)
+	result = FAIL;
+    return result;
+}
+/* kbd_ring_test
+ *
+ * Fills a keyboard ring like a pasted burst, checks that the code past a
+ * full ring is dropped and counted, then drains it across the wrap point
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: NONE
+ * Coverage: kbd_ring_push, kbd_ring_pop
+ */
+int kbd_ring_test()
+{
+    TEST_HEADER;
+    static kbd_ring_t r; /* too large for the stack */
+    int result = PASS;
+    uint32_t i;
+    uint8_t code;
+    uint64_t stamp;
+    memset(&r, 0, sizeof(r));
+    r.head = r.tail = 0xFFFFFFF0; /* indices wrap halfway through */
+    if (kbd_ring_pop(&r, &code, &stamp) != 0)
+	result = FAIL;
+    for (i = 0; i < KBD_FIFO_SIZE; i++) {
+	if (kbd_ring_push(&r, (uint8_t)i, i * 1000ULL) != 1)
+	    result = FAIL;
+    }
+    if (kbd_ring_push(&r, 0xAA, 0) != 0 || r.dropped != 1)
+	result = FAIL;
+    for (i = 0; i < KBD_FIFO_SIZE; i++) {
+	if (kbd_ring_pop(&r, &code, &stamp) != 1 || code != (uint8_t)i || stamp != i * 1000ULL)
+	    result = FAIL;
+    }
+    if (kbd_ring_pop(&r, &code, &stamp) != 0)
+	result = FAIL;
+    return result;
+}
+static DECLARE_WAIT_QUEUE(wait_test_wq);
+static volatile uint32_t wait_test_cond;
+static volatile uint32_t wait_test_done;
+static void wait_test_fn(uint32_t data)
+{
+    wait_event(wait_test_wq, wait_test_cond != 0);
+    wait_test_done = 1;
+}
+/* wait_queue_test
+ *
+ * Starts a kernel thread that sleeps on a wait queue, checks that it left
+ * the runqueue, then wakes it and checks that it is runnable again
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: starts a kernel thread that exits once woken
+ * Coverage: sleep_on, wake_up, wait_event
+ */
+int wait_queue_test()
+{
+    TEST_HEADER;
+    int result = PASS;
+    uint32_t i;
+    proc_t* p;
+    wait_test_cond = 0;
+    wait_test_done = 0;
+    p = kthread_create(wait_test_fn, 0, "wait_test", REGULAR_PRIO);
+    if (p == NULL)
+	return FAIL;
+    for (i = 0; i < 100 && !waitqueue_active(&wait_test_wq); i++)
+	asm volatile("hlt");
+    cli();
+    if (!waitqueue_active(&wait_test_wq) || p->array != NULL || p->state != TASK_INTERRUPTIBLE)
+	result = FAIL;
+    wake_up(&wait_test_wq); /* condition still false, the thread goes back to sleep */
+    if (waitqueue_active(&wait_test_wq) || p->array == NULL || p->state != TASK_RUNNING)
+	result = FAIL;
+    sti();
+    for (i = 0; i < 100 && !waitqueue_active(&wait_test_wq); i++)
+	asm volatile("hlt");
+    if (wait_test_done)
+	result = FAIL;
+    cli();
+    wait_test_cond = 1;
+    wake_up(&wait_test_wq);
+    if (p->array == NULL || p->state != TASK_RUNNING)
+	result = FAIL;
+    sti();
+    for (i = 0; i < 100 && !wait_test_done; i++)
+	asm volatile("hlt");
+    if (!wait_test_done)
+	result = FAIL;
+    return result;
+}
 /* Test suite entry point */
 void launch_tests(){
     vga_printf("Testing...\n");
@@ -1056,6 +1880,72 @@ void launch_tests(){
 	case 30:
 	    TEST_OUTPUT("VM SLAB ALLOC Tests", vm_alloc_tests());
 	    break;
+	case 31:
+	    TEST_OUTPUT("Scheduler priority array test", sched_prio_array_test());
+	    break;
+	case 32:
+	    TEST_OUTPUT("Clock math test", clock_math_test());
+	    break;
+	case 33:
+	    TEST_OUTPUT("Timer wheel test", timer_wheel_test());
+	    break;
+	case 34:
+	    TEST_OUTPUT("Lazy FPU test", fpu_lazy_test());
+	    break;
+	case 35:
+	    TEST_OUTPUT("Workqueue test", workqueue_test());
+	    break;
+	case 36:
+	    TEST_OUTPUT("CPU accounting test", rusage_test());
+	    break;
+	case 37:
+	    TEST_OUTPUT("Spinlock test", spinlock_test());
+	    break;
+	case 38:
+	    TEST_OUTPUT("List test", list_test());
+	    break;
+	case 39:
+	    TEST_OUTPUT("waitpid test", waitpid_test());
+	    break;
+	case 40:
+	    TEST_OUTPUT("RT scheduling test", rt_sched_test());
+	    break;
+	case 41:
+	    TEST_OUTPUT("Interactive boost test", interactive_boost_test());
+	    break;
+	case 42:
+	    TEST_OUTPUT("sysenter test", sysenter_test());
+	    break;
+	case 43:
+	    TEST_OUTPUT("vDSO test", vdso_test());
+	    break;
+	case 44:
+	    TEST_OUTPUT("Syscall stats test", syscall_stat_test());
+	    break;
+	case 45:
+	    TEST_OUTPUT("multicall test", multicall_test());
+	    break;
+	case 46:
+	    TEST_OUTPUT("pipe test", pipe_test());
+	    break;
+	case 47:
+	    TEST_OUTPUT("shared memory test", shm_test());
+	    break;
+	case 48:
+	    TEST_OUTPUT("exec cache test", exec_cache_test());
+	    break;
+	case 49:
+	    TEST_OUTPUT("ELF loader test", elf_load_test());
+	    break;
+	case 50:
+	    TEST_OUTPUT("spawn test", spawn_test());
+	    break;
+	case 51:
+	    TEST_OUTPUT("keyboard ring test", kbd_ring_test());
+	    break;
+	case 52:
+	    TEST_OUTPUT("wait queue test", wait_queue_test());
+	    break;
 	default:
 	    vga_printf("Invalid entry. Valid tests are:\n");
 	    vga_printf("0 -- IDT test\n1 -- Divide by 0 test\n2 -- Paging init test\n3 -- Memory functions test\n4 -- Init Filesystem test\n5 -- STD I/O tests\n6 -- Inode list test\n7 -- Invalid Opcode test\n8 -- System call test\n9 -- System call test\n10 -- Terminal read test\n11 -- Terminal close test\n12 -- RTC Functions Test\n13 -- FS File Open test\n14 -- FS File Read test\n15 -- FS File Write test\n16 -- FS File Close test\n17 -- FS Directory Open Test\n18 -- FS Directory Read Test\n19 -- FS Directory Write Test\n20 -- FS Directory Close Test\n");
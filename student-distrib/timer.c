@@ -0,0 +1,308 @@
+#ifndef TIMER_C
+#define TIMER_C
+#include "include/timer.h"
+#include "include/pit.h"
+#include "include/clock.h"
+#include "include/sched.h"
+/* wheel levels, each slot is the head of a NULL terminated list */
+static timer_list_t* tv1[TVR_SIZE];
+static timer_list_t* tvn[NUM_TVN][TVN_SIZE];
+static uint32_t timer_jiffies; /* next tick the wheel has not processed */
+static DEFINE_SPINLOCK(timer_lock); /* the wheel and timer_jiffies, also taken by the PIT interrupt */
+/*
+ * init_timers
+ *   DESCRIPTION: empties the wheel and syncs it with jiffies
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: drops every pending timer
+ */
+void init_timers()
+{
+    uint32_t i, j;
+    for (i = 0; i < TVR_SIZE; i++)
+	tv1[i] = NULL;
+    for (i = 0; i < NUM_TVN; i++)
+	for (j = 0; j < TVN_SIZE; j++)
+	    tvn[i][j] = NULL;
+    timer_jiffies = jiffies;
+}
+/*
+ * init_timer
+ *   DESCRIPTION: initializes a timer so it can be armed and cancelled
+ *   INPUTS: timer - timer to initialize
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+void init_timer(timer_list_t* timer)
+{
+    if (timer == NULL)
+	return;
+    timer->next   = NULL;
+    timer->prev   = NULL;
+    timer->bucket = NULL;
+}
+/*
+ * internal_add_timer
+ *   DESCRIPTION: links a timer into the bucket matching its distance from
+ *                timer_jiffies
+ *   INPUTS: timer - timer to link
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: timer_lock must be held
+ */
+static void internal_add_timer(timer_list_t* timer)
+{
+    uint32_t expires = timer->expires;
+    uint32_t delta   = expires - timer_jiffies;
+    timer_list_t** bucket;
+    if ((int32_t)delta < 0) { /* already due, fire on the next run */
+	bucket = &tv1[timer_jiffies & TVR_MASK];
+    } else if (delta < TVR_SIZE) {
+	bucket = &tv1[expires & TVR_MASK];
+    } else if (delta < (1 << (TVR_BITS + TVN_BITS))) {
+	bucket = &tvn[0][TVN_INDEX(expires, 1)];
+    } else if (delta < (1 << (TVR_BITS + 2 * TVN_BITS))) {
+	bucket = &tvn[1][TVN_INDEX(expires, 2)];
+    } else if (delta < (1 << (TVR_BITS + 3 * TVN_BITS))) {
+	bucket = &tvn[2][TVN_INDEX(expires, 3)];
+    } else {
+	bucket = &tvn[3][TVN_INDEX(expires, 4)];
+    }
+    timer->bucket = bucket;
+    timer->prev   = NULL;
+    timer->next   = *bucket;
+    if (*bucket != NULL)
+	(*bucket)->prev = timer;
+    *bucket = timer;
+}
+/*
+ * detach_timer
+ *   DESCRIPTION: unlinks a pending timer from its bucket
+ *   INPUTS: timer - timer to unlink
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: timer_lock must be held
+ */
+static void detach_timer(timer_list_t* timer)
+{
+    if (timer->prev == NULL)
+	*timer->bucket = timer->next;
+    else
+	timer->prev->next = timer->next;
+    if (timer->next != NULL)
+	timer->next->prev = timer->prev;
+    timer->next   = NULL;
+    timer->prev   = NULL;
+    timer->bucket = NULL;
+}
+/*
+ * add_timer
+ *   DESCRIPTION: arms a timer to fire once jiffies reaches timer->expires
+ *   INPUTS: timer - initialized timer with expires, function and data set
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: re-arms the timer if it was already pending
+ */
+void add_timer(timer_list_t* timer)
+{
+    uint32_t flags;
+    if (timer == NULL || timer->function == NULL)
+	return;
+    spin_lock_irqsave(&timer_lock, flags);
+    if (timer->bucket != NULL)
+	detach_timer(timer);
+    internal_add_timer(timer);
+    spin_unlock_irqrestore(&timer_lock, flags);
+}
+/*
+ * del_timer
+ *   DESCRIPTION: cancels a pending timer
+ *   INPUTS: timer - timer to cancel
+ *   OUTPUTS: none
+ *   RETURN VALUE: 1 if the timer was pending, 0 otherwise
+ *   SIDE EFFECTS: none
+ */
+int32_t del_timer(timer_list_t* timer)
+{
+    uint32_t flags;
+    int32_t pending = 0;
+    if (timer == NULL)
+	return 0;
+    spin_lock_irqsave(&timer_lock, flags);
+    if (timer->bucket != NULL) {
+	detach_timer(timer);
+	pending = 1;
+    }
+    spin_unlock_irqrestore(&timer_lock, flags);
+    return pending;
+}
+/*
+ * cascade
+ *   DESCRIPTION: re-files every timer of one bucket of an outer level into
+ *                the finer levels now that it came within their range
+ *   INPUTS: level - outer level index into tvn
+ *           index - bucket to empty
+ *   OUTPUTS: none
+ *   RETURN VALUE: index, so callers can tell when the level wrapped
+ *   SIDE EFFECTS: timer_lock must be held
+ */
+static uint32_t cascade(uint32_t level, uint32_t index)
+{
+    timer_list_t* timer = tvn[level][index];
+    timer_list_t* next;
+    tvn[level][index] = NULL;
+    while (timer != NULL) {
+	next = timer->next;
+	internal_add_timer(timer);
+	timer = next;
+    }
+    return index;
+}
+/*
+ * run_timers
+ *   DESCRIPTION: advances the wheel up to jiffies, firing every timer in
+ *                the root slots it passes. Work per tick is bounded by the
+ *                expired bucket plus an occasional cascade.
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: timer functions run without timer_lock and with the
+ *                 caller's interrupt flag, so they may re-arm themselves
+ */
+void run_timers()
+{
+    uint32_t flags;
+    uint32_t index, level;
+    timer_list_t* timer;
+    spin_lock_irqsave(&timer_lock, flags);
+    while (time_after_eq(jiffies, timer_jiffies)) {
+	index = timer_jiffies & TVR_MASK;
+	/* root level wrapped, pull the next span down from the outer levels */
+	if (index == 0) {
+	    for (level = 0; level < NUM_TVN; level++) {
+		if (cascade(level, TVN_INDEX(timer_jiffies, level + 1)) != 0)
+		    break;
+	    }
+	}
+	timer_jiffies += 1;
+	while ((timer = tv1[index]) != NULL) {
+	    detach_timer(timer);
+	    spin_unlock_irqrestore(&timer_lock, flags);
+	    timer->function(timer->data);
+	    spin_lock_irqsave(&timer_lock, flags);
+	}
+    }
+    spin_unlock_irqrestore(&timer_lock, flags);
+}
+/*
+ * timer_pending_work
+ *   DESCRIPTION: cheap check made from the PIT interrupt. Steps the wheel
+ *                over ticks with nothing to do and stops at the first tick
+ *                that has timers to fire or a cascade to run.
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: 1 if run_timers has work, 0 otherwise
+ *   SIDE EFFECTS: must be called with interrupts off
+ */
+int32_t timer_pending_work()
+{
+    uint32_t index;
+    int32_t pending = 0;
+    spin_lock(&timer_lock);
+    while (time_after_eq(jiffies, timer_jiffies)) {
+	index = timer_jiffies & TVR_MASK;
+	if (tv1[index] != NULL || index == 0) {
+	    pending = 1;
+	    break;
+	}
+	timer_jiffies += 1;
+    }
+    spin_unlock(&timer_lock);
+    return pending;
+}
+/*
+ * timer_next_expiry
+ *   DESCRIPTION: finds how many ticks from now the first root slot holding
+ *                a timer is, looking no further than max_ticks. Stops at a
+ *                root wrap since a cascade may bring timers due right then.
+ *   INPUTS: max_ticks - how far ahead the caller can use the answer
+ *   OUTPUTS: none
+ *   RETURN VALUE: ticks to the next expiry, NO_TIMER_DEADLINE if beyond max_ticks
+ *   SIDE EFFECTS: none
+ */
+uint32_t timer_next_expiry(uint32_t max_ticks)
+{
+    uint32_t flags;
+    uint32_t t, i;
+    uint32_t ticks = NO_TIMER_DEADLINE;
+    spin_lock_irqsave(&timer_lock, flags);
+    t = timer_jiffies;
+    for (i = 0; i <= max_ticks; i++, t++) {
+	if (tv1[t & TVR_MASK] != NULL || (t & TVR_MASK) == 0) {
+	    ticks = (time_after_eq(jiffies, t)) ? 0 : t - jiffies;
+	    break;
+	}
+    }
+    spin_unlock_irqrestore(&timer_lock, flags);
+    return ticks;
+}
+/*
+ * ms_to_jiffies
+ *   DESCRIPTION: converts ms to PIT ticks, rounding up
+ *   INPUTS: ms - interval in ms
+ *   OUTPUTS: none
+ *   RETURN VALUE: interval in ticks
+ *   SIDE EFFECTS: none
+ */
+uint32_t ms_to_jiffies(uint32_t ms)
+{
+    uint32_t msec_per_tick = TICK_NSEC / NSEC_PER_MSEC;
+    return ms / msec_per_tick + ((ms % msec_per_tick) ? 1 : 0);
+}
+/* state shared by a sleeping task and its wake up timer */
+struct sleep_state {
+    uint32_t     done;
+    wait_queue_t wq;
+};
+/*
+ * sleep_timeout
+ *   DESCRIPTION: timer function waking a task parked in sleep_ticks
+ *   INPUTS: data - pointer to the sleeper's sleep_state
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+static void sleep_timeout(uint32_t data)
+{
+    struct sleep_state* state = (struct sleep_state*)data;
+    state->done = 1;
+    wake_up(&state->wq);
+}
+/*
+ * sleep_ticks
+ *   DESCRIPTION: parks the current task until ticks PIT ticks have passed
+ *   INPUTS: ticks - ticks to sleep
+ *   OUTPUTS: none
+ *   RETURN VALUE: 0
+ *   SIDE EFFECTS: timer and wait queue live on this task's kernel stack
+ */
+int32_t sleep_ticks(uint32_t ticks)
+{
+    struct sleep_state state;
+    timer_list_t timer;
+    if (ticks == 0)
+	return 0;
+    state.done = 0;
+    init_waitqueue(&state.wq);
+    init_timer(&timer);
+    timer.expires  = jiffies + ticks;
+    timer.function = sleep_timeout;
+    timer.data     = (uint32_t)&state;
+    add_timer(&timer);
+    wait_event(state.wq, state.done);
+    del_timer(&timer);
+    return 0;
+}
+#endif
@@ -0,0 +1,72 @@
+#ifndef VDSO_C
+#define VDSO_C
+#include "include/vdso.h"
+#include "include/sys_call.h"
+#include "include/page.h"
+#include "include/clock.h"
+#include "include/pit.h"
+#include "include/task.h"
+#include "include/lib.h"
+
+/* data page mapped read-only at USER_VDSO_DATA_ADDR */
+union vdso_page {
+    vdso_data_t data;
+    uint8_t     bytes[__4KB__];
+} __attribute__((aligned(__4KB__)));
+static union vdso_page vdso_page;
+/*
+ * vdso_init
+ *   DESCRIPTION: fills the clock parameters of the data page, copies the
+ *                user functions into the stub page and maps the data page
+ *                read-only for user space. Runs after clock_init and
+ *                sysenter_init, which already set the page directory entry.
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: modifies user_pte
+ */
+void vdso_init()
+{
+    vdso_data_t* d = &vdso_page.data;
+    memset(&vdso_page, 0, sizeof(vdso_page));
+    d->pid         = KERNEL_PID;
+    d->jiffies     = jiffies;
+    d->tick_nsec   = TICK_NSEC;
+    d->tsc_khz     = tsc_khz;
+    d->clock_mult  = clock_mult;
+    d->clock_shift = CLOCK_SHIFT;
+    d->tsc_base    = tsc_base;
+    memcpy(vsyscall_page + VDSO_TEXT_OFFSET, vdso_text, vdso_text_end - vdso_text);
+    user_pte.pages[(USER_VDSO_DATA_ADDR >> PAGE_BITSHIFT) & PAGE_TABLE_MAX_SIZE] =
+	(uint32_t)&vdso_page | PRESENT | USER_EN;
+    flush_tlb_single(USER_VDSO_DATA_ADDR);
+}
+/*
+ * vdso_set_task
+ *   DESCRIPTION: publishes the task that is about to run. No user task
+ *                runs while it changes.
+ *   INPUTS: p - the new current task
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+void vdso_set_task(proc_t* p)
+{
+    vdso_data_t* d = &vdso_page.data;
+    d->pid         = p->pid;
+    d->terminal_id = p->terminal_id;
+}
+/*
+ * vdso_tick
+ *   DESCRIPTION: copies jiffies into the page, called by the PIT tick and
+ *                when jiffies catches up after idling
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+void vdso_tick()
+{
+    vdso_page.data.jiffies = jiffies;
+}
+#endif
@@ -0,0 +1,111 @@
+#ifndef WAIT_C
+#define WAIT_C
+#include "include/wait.h"
+#include "include/sched.h"
+#include "include/task.h"
+/*
+ * init_waitqueue
+ *   DESCRIPTION: initializes an empty wait queue
+ *   INPUTS: wq -- wait queue to initialize
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+void init_waitqueue(wait_queue_t* wq)
+{
+    if (wq == NULL)
+	return;
+    INIT_LIST_HEAD(&wq->task_list);
+    spin_lock_init(&wq->lock, (const int8_t*)"waitqueue");
+}
+/*
+ * waitqueue_active
+ *   DESCRIPTION: checks whether any task sleeps on a wait queue
+ *   INPUTS: wq -- wait queue to check
+ *   OUTPUTS: none
+ *   RETURN VALUE: 1 if there are sleepers, 0 otherwise
+ *   SIDE EFFECTS: none
+ */
+int32_t waitqueue_active(wait_queue_t* wq)
+{
+    return (wq != NULL && !list_empty(&wq->task_list));
+}
+/*
+ * sleep_on
+ *   DESCRIPTION: blocks the current task on a wait queue and switches away.
+ *                Returns once a wake_up on the queue made it runnable and it
+ *                has been scheduled again. Callers re-check their condition.
+ *   INPUTS: wq -- wait queue to sleep on
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: must be called with interrupts off. The idle task never
+ *                 blocks, it just lets pending interrupts run.
+ */
+void sleep_on(wait_queue_t* wq)
+{
+    proc_t* p = current_proc;
+    if (wq == NULL || p == NULL)
+	return;
+    if (p == runqueue.idle_pcb || p->pid == KERNEL_PID) {
+	sti();
+	cli();
+	return;
+    }
+    spin_lock(&wq->lock);
+    list_add_tail(&p->wait_list, &wq->task_list);
+    spin_unlock(&wq->lock);
+    deactivate_task(p);
+    p->state = TASK_INTERRUPTIBLE;
+    schedule();
+}
+/*
+ * __wake_up
+ *   DESCRIPTION: empties a wait queue, putting every sleeper back on the
+ *                runqueue
+ *   INPUTS: wq -- wait queue to wake
+ *           boost -- nonzero to give the sleepers the keyboard wake boost
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: requests a reschedule when a woken task beats the running
+ *                 one, safe to call from interrupt handlers. The sleepers are
+ *                 spliced off in one step so the wait queue lock is not held
+ *                 while the runqueue is locked.
+ */
+static void __wake_up(wait_queue_t* wq, uint8_t boost)
+{
+    uint32_t flags;
+    list_head_t* node;
+    list_head_t* next;
+    proc_t* p;
+    LIST_HEAD(woken);
+    if (wq == NULL)
+	return;
+    spin_lock_irqsave(&wq->lock, flags);
+    list_splice_tail_init(&wq->task_list, &woken);
+    spin_unlock_irqrestore(&wq->lock, flags);
+    list_for_each_safe(node, next, &woken) {
+	p = list_entry(node, proc_t, wait_list);
+	list_del_init(node);
+	p->wake_boost = boost;
+	activate_task(p); /* also requests a preemption if p beats the running task */
+    }
+}
+/*
+ * wake_up / wake_up_interactive
+ *   DESCRIPTION: wake every sleeper of a wait queue. wake_up_interactive is
+ *                for input the user is waiting on, the sleepers run ahead of
+ *                other normal tasks until they block or use up a slice.
+ *   INPUTS: wq -- wait queue to wake
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: see __wake_up
+ */
+void wake_up(wait_queue_t* wq)
+{
+    __wake_up(wq, 0);
+}
+void wake_up_interactive(wait_queue_t* wq)
+{
+    __wake_up(wq, 1);
+}
+#endif
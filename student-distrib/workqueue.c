@@ -0,0 +1,116 @@
+#ifndef WORKQUEUE_C
+#define WORKQUEUE_C
+#include "include/workqueue.h"
+#include "include/kthread.h"
+#include "include/sched.h"
+workqueue_t events_wq = { NULL, NULL, SPIN_LOCK_UNLOCKED(events_wq), __WAIT_QUEUE_INITIALIZER(events_wq.wait), NULL };
+/*
+ * worker_thread
+ *   DESCRIPTION: body of a workqueue's kernel thread. Sleeps until work is
+ *                queued, then runs the items one at a time with interrupts
+ *                enabled.
+ *   INPUTS: data -- the workqueue_t to serve
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: never returns
+ */
+static void worker_thread(uint32_t data)
+{
+    workqueue_t* wq = (workqueue_t*)data;
+    work_t* work;
+    uint32_t flags;
+    while (1) {
+	cli_and_save(flags);      /* a wake up between the test and sleep_on must not be lost */
+	while (wq->head == NULL)
+	    sleep_on(&wq->wait);
+	spin_lock(&wq->lock);
+	work = wq->head;
+	wq->head = work->next;
+	if (wq->head == NULL)
+	    wq->last = NULL;
+	work->next    = NULL;
+	work->pending = 0;        /* may be queued again while it runs */
+	spin_unlock(&wq->lock);
+	restore_flags(flags);
+	work->func(work->data);
+    }
+}
+/*
+ * init_workqueue
+ *   DESCRIPTION: initializes a workqueue and starts its worker thread. Work
+ *                queued before this call is kept and run once the worker
+ *                starts.
+ *   INPUTS: wq       -- workqueue to set up
+ *           name     -- name of the worker thread
+ *           priority -- scheduling class of the worker
+ *   OUTPUTS: none
+ *   RETURN VALUE: 0 on success, -1 if no thread could be created
+ *   SIDE EFFECTS: creates a kernel thread
+ */
+int32_t init_workqueue(workqueue_t* wq, const int8_t* name, uint8_t priority)
+{
+    if (wq == NULL)
+	return -1;
+    if (wq->wait.task_list.next == NULL) /* zeroed, not statically initialized */
+	init_waitqueue(&wq->wait);
+    wq->worker = kthread_create(worker_thread, (uint32_t)wq, name, priority);
+    return (wq->worker == NULL) ? -1 : 0;
+}
+/*
+ * init_workqueues
+ *   DESCRIPTION: starts the shared events worker used by interrupt handlers.
+ *                It runs in the real time class so deferred input and timer
+ *                work preempts user programs as soon as it is queued.
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: creates a kernel thread
+ */
+void init_workqueues()
+{
+    init_workqueue(&events_wq, (const int8_t*)"events", REAL_TIME_PRIO);
+}
+/*
+ * queue_work
+ *   DESCRIPTION: appends a work item to a workqueue and wakes its worker.
+ *                Safe to call from interrupt handlers.
+ *   INPUTS: wq   -- workqueue to add to
+ *           work -- item to run
+ *   OUTPUTS: none
+ *   RETURN VALUE: 1 if queued, 0 if it was already pending
+ *   SIDE EFFECTS: may set runqueue.need_resched
+ */
+int32_t queue_work(workqueue_t* wq, work_t* work)
+{
+    uint32_t flags;
+    if (wq == NULL || work == NULL || work->func == NULL)
+	return 0;
+    spin_lock_irqsave(&wq->lock, flags);
+    if (work->pending) {
+	spin_unlock_irqrestore(&wq->lock, flags);
+	return 0;
+    }
+    work->pending = 1;
+    work->next    = NULL;
+    if (wq->last == NULL)
+	wq->head = work;
+    else
+	wq->last->next = work;
+    wq->last = work;
+    wake_up(&wq->wait);
+    spin_unlock_irqrestore(&wq->lock, flags);
+    return 1;
+}
+/*
+ * schedule_work
+ *   DESCRIPTION: queues a work item on the shared events workqueue
+ *   INPUTS: work -- item to run
+ *   OUTPUTS: none
+ *   RETURN VALUE: 1 if queued, 0 if it was already pending
+ *   SIDE EFFECTS: see queue_work
+ */
+int32_t schedule_work(work_t* work)
+{
+    return queue_work(&events_wq, work);
+}
+#endif